@@ -0,0 +1,393 @@
+//
+// cmamemcpy.c
+//
+// For questions/support: norman.mcentire@gmail.com
+//
+// To build: gcc -Wall cmamemcpy.c -o cmamemcpy
+//
+// Single-copy transfer with cross-memory attach.  Only addresses travel
+// over a small control channel (a socketpair); the payload is copied once,
+// directly between the two address spaces:
+//
+//   --mode pull  the parent sends the address of src and the child copies
+//                it into dst with process_vm_readv()
+//   --mode push  the child sends the address of dst, the parent copies src
+//                into it with process_vm_writev() and then signals done
+//
+// Both need ptrace access to the peer.  Under Yama (ptrace_scope 1) a child
+// may not attach to its parent, so in pull mode the parent allows it with
+// PR_SET_PTRACER.
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <getopt.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/prctl.h>
+#include <poll.h>
+#include "perfcount.h"
+#include "crc32c.h"
+#include "ipcstream.h"
+#include "ipcresult.h"
+#include "ipcpayload.h"
+#include "ipctrace.h"
+
+enum { MODE_PULL = 0, MODE_PUSH };
+
+typedef struct {
+    struct timeval start;
+    struct timeval end;
+    uint64_t size;
+    uint32_t crc;       // CRC32C of data[], set by the sender with --verify
+    uint8_t data[];
+} buf_data_t;
+
+// Control message: where the buffer lives in the sender's address space
+typedef struct {
+    uint64_t addr;
+    uint64_t len;
+} cma_ctl_t;
+
+volatile sig_atomic_t sigusr1_received = 0;
+
+void handle_sigusr1(int sig) {
+    sigusr1_received = 1;
+}
+
+ssize_t full_write(int fd, const void *buf, size_t count) {
+    size_t written = 0;
+    while (written < count) {
+        ssize_t res = write(fd, (char *)buf + written, count - written);
+        if (res <= 0) return res;
+        written += res;
+    }
+    return written;
+}
+
+ssize_t full_read(int fd, void *buf, size_t count) {
+    size_t read_bytes = 0;
+    while (read_bytes < count) {
+        ssize_t res = read(fd, (char *)buf + read_bytes, count - read_bytes);
+        if (res <= 0) return res;
+        read_bytes += res;
+    }
+    return read_bytes;
+}
+
+// process_vm_readv/writev may move less than asked (at most MAX_RW_COUNT
+// per call), so keep going until the whole range has been copied
+int cma_copy(pid_t pid, void *local, uint64_t remote, size_t len, int push) {
+    size_t done = 0;
+    while (done < len) {
+        struct iovec l = { (char *)local + done, len - done };
+        struct iovec r = { (void *)(uintptr_t)(remote + done), len - done };
+        ssize_t n = push ? process_vm_writev(pid, &l, 1, &r, 1, 0)
+                         : process_vm_readv(pid, &l, 1, &r, 1, 0);
+        if (n <= 0) return -1;
+        done += n;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t size = 0;
+    int perf = 0;
+    int trace_table = 0;
+    const char *trace_json = NULL;
+    int verify = 0;  // 1: checksum outside the timed region, 2: inside
+    int mode = MODE_PULL;
+    int format = RESULT_TEXT;
+    const char *output = NULL;  // Append records here instead of stdout
+    int pattern = PATTERN_SEQ;
+    long src_align = -1, dst_align = -1;  // Payload offsets in a page; -1 leaves malloc() placement
+
+    static struct option long_options[] = {
+        {"size", required_argument, 0, 's'},
+        {"perf", no_argument, 0, 'P'},
+        {"trace", no_argument, 0, 'T'},
+        {"trace-json", required_argument, 0, 'J'},
+        {"verify", no_argument, 0, 'V'},
+        {"verify-timed", no_argument, 0, 'I'},
+        {"mode", required_argument, 0, 'm'},
+        {"pattern", required_argument, 0, 'D'},
+        {"align", required_argument, 0, 'A'},
+        {"format", required_argument, 0, 'f'},
+        {"output", required_argument, 0, 'o'},
+        {0, 0, 0, 0}
+    };
+
+    while (1) {
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "s:PTJ:VIm:D:A:f:o:", long_options, &option_index);
+        if (c == -1) break;
+
+        switch (c) {
+            case 's':
+                if (parse_size(optarg, &size) < 0) {
+                    fprintf(stderr, "Invalid size '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'P':
+                perf = 1;
+                break;
+            case 'T':
+                trace_table = 1;
+                break;
+            case 'J':
+                trace_json = optarg;
+                break;
+            case 'V':
+                verify = 1;
+                break;
+            case 'I':
+                verify = 2;
+                break;
+            case 'm':
+                if (strcmp(optarg, "pull") == 0) mode = MODE_PULL;
+                else if (strcmp(optarg, "push") == 0) mode = MODE_PUSH;
+                else {
+                    fprintf(stderr, "Invalid mode '%s' (expected pull or push).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'D':
+                pattern = payload_pattern_parse(optarg);
+                if (pattern < 0) {
+                    fprintf(stderr, "Invalid pattern '%s' (expected seq, random or zero).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'A':
+                if (payload_align_parse(optarg, &src_align, &dst_align) < 0) {
+                    fprintf(stderr, "Invalid alignment '%s' (SRC[,DST] bytes past a page boundary).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'f':
+                format = result_format_parse(optarg);
+                if (format < 0) {
+                    fprintf(stderr, "Invalid format '%s' (expected text, json or csv).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s --size NUMBER [--mode pull|push] [--perf] [--trace] [--trace-json FILE] [--verify|--verify-timed] [--pattern seq|random|zero] [--align SRC[,DST]] [--format text|json|csv] [--output FILE]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    result_redirect_text(format, output);
+
+    if (size == 0) {
+        fprintf(stderr, "Invalid size specified.\n");
+        return EXIT_FAILURE;
+    }
+
+    size_t total_size = sizeof(buf_data_t) + size;
+
+    payload_buf_t sb;
+    buf_data_t *src = payload_alloc(&sb, sizeof(buf_data_t), size, src_align, pattern == PATTERN_ZERO);
+    if (!src) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    src->size = size;
+    payload_fill(src->data, size, pattern);
+
+    // Control channel for addresses and the push completion
+    int ctl[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, ctl) < 0) {
+        perror("socketpair");
+        payload_free(&sb);
+        return EXIT_FAILURE;
+    }
+
+    // Shared between parent and child, so it must exist before fork
+    ipc_trace_t *trace = NULL;
+    if (trace_table || trace_json) trace = ipc_trace_create();
+
+    // Install before fork so the child's ready signal cannot arrive first
+    signal(SIGUSR1, handle_sigusr1);
+
+    pid_t child_pid = fork();
+    if (child_pid < 0) {
+        perror("fork");
+        payload_free(&sb);
+        return EXIT_FAILURE;
+    }
+
+    if (child_pid == 0) {
+        // --- Child Process (Receiver) ---
+        close(ctl[0]);
+        int fd = ctl[1];
+
+        payload_buf_t db;
+        buf_data_t *dst = payload_alloc(&db, sizeof(buf_data_t), size, dst_align, 0);
+        if (!dst) {
+            perror("Child malloc");
+            exit(EXIT_FAILURE);
+        }
+
+        perf_counters_t pc;
+        if (perf) perf_counters_open(&pc);
+        if (perf) perf_counters_start(&pc);
+
+        if (mode == MODE_PUSH) {
+            cma_ctl_t msg = { (uintptr_t)dst, total_size };
+            if (full_write(fd, &msg, sizeof(msg)) != sizeof(msg)) {
+                perror("Child write");
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        kill(getppid(), SIGUSR1); // Notify parent
+
+        // Only when tracing: separate the wakeup from the copy
+        if (trace) {
+            struct pollfd pfd = { .fd = fd, .events = POLLIN };
+            poll(&pfd, 1, -1);
+            ipc_trace_mark(trace, IPC_TRACE_CHILD, "receiver wakeup");
+        }
+
+        int failed;
+        if (mode == MODE_PULL) {
+            cma_ctl_t msg;
+            failed = full_read(fd, &msg, sizeof(msg)) != sizeof(msg) || msg.len != total_size;
+            ipc_trace_mark(trace, IPC_TRACE_CHILD, "address received");
+            if (!failed) failed = cma_copy(getppid(), dst, msg.addr, total_size, 0) < 0;
+            ipc_trace_mark(trace, IPC_TRACE_CHILD, "copy done");
+        } else {
+            char done;
+            failed = full_read(fd, &done, 1) != 1;
+            ipc_trace_mark(trace, IPC_TRACE_CHILD, "completion received");
+        }
+        if (failed) {
+            perror(mode == MODE_PULL ? "Child process_vm_readv" : "Child: No completion from parent");
+            payload_free(&db);
+            close(fd);
+            exit(EXIT_FAILURE);
+        }
+
+        uint32_t crc = 0;
+        if (verify == 2) crc = crc32c(0, dst->data, size);
+
+        gettimeofday(&dst->end, NULL);
+        if (perf) perf_counters_stop(&pc);
+
+        if (verify == 1) crc = crc32c(0, dst->data, size);
+
+        long sec = dst->end.tv_sec - dst->start.tv_sec;
+        long usec = dst->end.tv_usec - dst->start.tv_usec;
+        if (usec < 0) {
+            sec--;
+            usec += 1000000;
+        }
+
+        double elapsed = sec + usec / 1e6;
+        double bps = elapsed > 0 ? (dst->size / elapsed) : 0;
+        double mbps = bps / 1e6;
+
+        printf("[Child] Elapsed Time: %.6f seconds\n", elapsed);
+        printf("[Child] Transferred:  %" PRIu64 " bytes\n", dst->size);
+        printf("[Child] Throughput:   %.2f bytes/sec (%.2f MB/sec)\n", bps, mbps);
+        result_print_peak("[Child] ", bps);
+        printf("[Child] CMA Mode:     %s\n",
+               mode == MODE_PULL ? "pull (child process_vm_readv)" : "push (parent process_vm_writev)");
+        ipc_trace_mark(trace, IPC_TRACE_CHILD, "post-processing");
+        if (perf) {
+            perf_counters_print(&pc, "[Child] ");
+            perf_counters_close(&pc);
+        }
+
+        int ok = !verify || (crc32c_report_size("[Child] ", size, dst->size) == 0 &&
+                                crc32c_report("[Child] ", dst->crc, crc) == 0);
+
+        long src_offset = payload_offset(src_align, pattern == PATTERN_ZERO);
+        ipc_payload_t pl = { payload_pattern_names[pattern], src_offset, dst_align };
+        ipc_result_t result = { mode == MODE_PULL ? "cma-pull" : "cma-push", dst->size, elapsed,
+                                verify ? ok : -1, NULL, &pl };
+        result_emit(format, output, &result);
+
+        payload_free(&db);
+        close(fd);
+        exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+    } else {
+        // --- Parent Process (Sender) ---
+        close(ctl[1]);
+        int fd = ctl[0];
+
+        // Let the child attach to us despite Yama's descendants-only rule
+        if (mode == MODE_PULL) prctl(PR_SET_PTRACER, child_pid, 0, 0, 0);
+
+        while (!sigusr1_received) pause();
+
+        cma_ctl_t remote = { 0 };
+        if (mode == MODE_PUSH && full_read(fd, &remote, sizeof(remote)) != sizeof(remote)) {
+            perror("Parent read");
+            kill(child_pid, SIGTERM);
+            waitpid(child_pid, NULL, 0);
+            payload_free(&sb);
+            return EXIT_FAILURE;
+        }
+
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "connected");
+
+        if (verify == 1) src->crc = crc32c(0, src->data, size);
+
+        perf_counters_t pc;
+        if (perf) perf_counters_open(&pc);
+
+        if (perf) perf_counters_start(&pc);
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "pre-send");
+        gettimeofday(&src->start, NULL);
+
+        if (verify == 2) src->crc = crc32c(0, src->data, size);
+
+        int failed;
+        if (mode == MODE_PULL) {
+            // src must stay untouched until the child has exited
+            cma_ctl_t msg = { (uintptr_t)src, total_size };
+            failed = full_write(fd, &msg, sizeof(msg)) != sizeof(msg);
+        } else {
+            failed = remote.len != total_size || cma_copy(child_pid, src, remote.addr, total_size, 1) < 0;
+            ipc_trace_mark(trace, IPC_TRACE_PARENT, "copy done");
+            char done = 1;
+            if (!failed) failed = full_write(fd, &done, 1) != 1;
+        }
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "send return");
+        if (failed) {
+            perror(mode == MODE_PULL ? "Parent write" : "Parent process_vm_writev");
+        }
+        if (perf) perf_counters_stop(&pc);
+
+        close(fd);
+        int status;
+        wait(&status);
+        if (perf) {
+            perf_counters_print(&pc, "[Parent] ");
+            perf_counters_close(&pc);
+        }
+
+        if (trace_table) ipc_trace_print_table(trace);
+        if (trace_json) ipc_trace_write_chrome(trace, trace_json);
+        ipc_trace_destroy(trace);
+        payload_free(&sb);
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
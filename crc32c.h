@@ -0,0 +1,140 @@
+//
+// crc32c.h
+//
+// For questions/support: norman.mcentire@gmail.com
+//
+// CRC32C (Castagnoli) for end-to-end payload verification.
+//
+// Uses the SSE4.2 crc32 instruction on x86-64 (selected at run time) or
+// the ARMv8 CRC32 extension when the compiler targets it, and falls back
+// to a table-driven implementation otherwise.  The value chains, so
+// crc32c(crc32c(0, a, n), b, m) equals the CRC of a followed by b.
+//
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+static uint32_t crc32c_table[256];
+
+static uint32_t crc32c_sw(uint32_t crc, const uint8_t *p, size_t len) {
+    if (crc32c_table[1] == 0) {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t c = i;
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? (c >> 1) ^ 0x82F63B78u : c >> 1;
+            }
+            crc32c_table[i] = c;
+        }
+    }
+
+    while (len--) {
+        crc = crc32c_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len) {
+    uint64_t c = crc;
+    while (len && ((uintptr_t)p & 7)) {
+        c = _mm_crc32_u8((uint32_t)c, *p++);
+        len--;
+    }
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        c = _mm_crc32_u64(c, v);
+        p += 8;
+        len -= 8;
+    }
+    while (len--) {
+        c = _mm_crc32_u8((uint32_t)c, *p++);
+    }
+    return (uint32_t)c;
+}
+
+static int crc32c_have_hw(void) {
+    return __builtin_cpu_supports("sse4.2");
+}
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len) {
+    while (len && ((uintptr_t)p & 7)) {
+        crc = __crc32cb(crc, *p++);
+        len--;
+    }
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        crc = __crc32cd(crc, v);
+        p += 8;
+        len -= 8;
+    }
+    while (len--) {
+        crc = __crc32cb(crc, *p++);
+    }
+    return crc;
+}
+
+static int crc32c_have_hw(void) {
+    return 1;
+}
+#else
+#define crc32c_hw crc32c_sw
+
+static int crc32c_have_hw(void) {
+    return 0;
+}
+#endif
+
+static const char *crc32c_impl(void) {
+#if defined(__x86_64__)
+    return crc32c_have_hw() ? "sse4.2" : "software";
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+    return "armv8-crc";
+#else
+    return "software";
+#endif
+}
+
+static uint32_t crc32c(uint32_t crc, const void *buf, size_t len) {
+    crc = ~crc;
+    if (crc32c_have_hw()) {
+        crc = crc32c_hw(crc, buf, len);
+    } else {
+        crc = crc32c_sw(crc, buf, len);
+    }
+    return ~crc;
+}
+
+// Prints the verification line and returns 0 on match, -1 on mismatch
+// The header's size is the sender's claim; a receiver checksums the size
+// it expected, and a header that disagrees fails verification outright
+static inline int crc32c_report_size(const char *prefix, uint64_t expected, uint64_t actual) {
+    if (expected == actual) return 0;
+    printf("%sVerified:     FAILED (expected %" PRIu64 " bytes, header says %" PRIu64 ")\n",
+           prefix, expected, actual);
+    return -1;
+}
+
+static inline int crc32c_report(const char *prefix, uint32_t expected, uint32_t actual) {
+    if (expected == actual) {
+        printf("%sVerified:     OK (crc32c 0x%08x, %s)\n", prefix, actual, crc32c_impl());
+        return 0;
+    }
+    printf("%sVerified:     FAILED (expected crc32c 0x%08x, got 0x%08x)\n",
+           prefix, expected, actual);
+    return -1;
+}
+
+#endif // CRC32C_H
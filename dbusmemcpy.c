@@ -4,11 +4,24 @@
 //
 // To build: gcc -Wall dbusmemcpy.c -o dbusmemcpy $(pkg-config --cflags --libs dbus-1)
 //
+// Modes:
+//   --mode bus     (default) route through the session bus daemon
+//   --mode bus --private-bus  launch a dbus-daemon just for this run
+//   --mode direct  peer-to-peer over a unix socket, no daemon hop
+//
+// --codec raw|tlv|dbus sends structured records (see ipcrecord.h), as many
+// as fit raw in --size, and times encoding and decoding apart from the
+// transfer.  raw and tlv travel inside the usual byte array; dbus marshals
+// every record as a struct of typed arguments (RECORD_DBUS_SIGNATURE), the
+// way a real D-Bus API would carry them.  Those go first, followed by the
+// sender's encode time, so the payload's start time is taken after them.
+//
 
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/time.h>
@@ -16,12 +29,25 @@
 #include <signal.h>
 #include <errno.h>
 #include <sys/wait.h>
+#include <poll.h>
 #include <dbus/dbus.h>
+#include "perfcount.h"
+#include "crc32c.h"
+#include "ipcstream.h"
+#include "ipcresult.h"
+#include "ipctrace.h"
+#include "ipclat.h"
+#include "ipcrecord.h"
+
+#define DIRECT_ADDRESS_FMT "unix:path=/tmp/dbusmemcpy-%d"
+#define RECORD_DBUS_SIGNATURE "(txuiqnyybddadss)"
+#define MAX_WATCHES 8
 
 typedef struct {
     struct timeval start;
     struct timeval end;
-    uint32_t size;
+    uint64_t size;
+    uint32_t crc;       // CRC32C of data[], set by the sender with --verify
     uint8_t data[];
 } buf_data_t;
 
@@ -31,34 +57,354 @@ void handle_sigusr1(int sig) {
     sigusr1_received = 1;
 }
 
+// Start a private dbus-daemon for this run and return its address.
+// The daemon prints its address on the pipe once it is listening.
+pid_t launch_private_bus(char *address, size_t len) {
+    int fds[2];
+    if (pipe(fds) < 0) {
+        perror("pipe");
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        close(fds[0]);
+        close(fds[1]);
+        return -1;
+    }
+
+    if (pid == 0) {
+        char print_address[32];
+        close(fds[0]);
+        snprintf(print_address, sizeof(print_address), "--print-address=%d", fds[1]);
+        execlp("dbus-daemon", "dbus-daemon", "--session", "--nofork", print_address, (char *)NULL);
+        perror("execlp dbus-daemon");
+        _exit(EXIT_FAILURE);
+    }
+
+    close(fds[1]);
+    size_t used = 0;
+    while (used < len - 1) {
+        ssize_t n = read(fds[0], address + used, len - 1 - used);
+        if (n <= 0) break;
+        used += n;
+        if (memchr(address, '\n', used)) break;
+    }
+    close(fds[0]);
+    address[used] = '\0';
+    address[strcspn(address, "\n")] = '\0';
+
+    if (address[0] == '\0') {
+        fprintf(stderr, "Failed to read private dbus-daemon address\n");
+        kill(pid, SIGTERM);
+        waitpid(pid, NULL, 0);
+        return -1;
+    }
+    return pid;
+}
+
+// Parent error paths: neither the child nor a private daemon may outlive us
+void stop_children(pid_t child_pid, pid_t bus_pid) {
+    kill(child_pid, SIGTERM);
+    waitpid(child_pid, NULL, 0);
+    if (bus_pid > 0) {
+        kill(bus_pid, SIGTERM);
+        waitpid(bus_pid, NULL, 0);
+    }
+}
+
+// Minimal watch handling so a DBusServer can accept without a main loop:
+// every watch the server adds is kept, and the enabled ones are polled
+typedef struct {
+    DBusWatch *w[MAX_WATCHES];
+    int n;
+} watch_set_t;
+
+dbus_bool_t server_add_watch(DBusWatch *watch, void *data) {
+    watch_set_t *set = data;
+    if (set->n == MAX_WATCHES) return FALSE;
+    set->w[set->n++] = watch;
+    return TRUE;
+}
+
+void server_remove_watch(DBusWatch *watch, void *data) {
+    watch_set_t *set = data;
+    for (int i = 0; i < set->n; i++) {
+        if (set->w[i] == watch) {
+            set->w[i] = set->w[--set->n];
+            return;
+        }
+    }
+}
+
+int watch_set_has(const watch_set_t *set, DBusWatch *watch) {
+    for (int i = 0; i < set->n; i++) {
+        if (set->w[i] == watch) return 1;
+    }
+    return 0;
+}
+
+void server_new_connection(DBusServer *server, DBusConnection *conn, void *data) {
+    dbus_connection_ref(conn);
+    *(DBusConnection **)data = conn;
+}
+
+// Block until one peer connects to the server
+DBusConnection *accept_peer(DBusServer *server) {
+    watch_set_t watches = { .n = 0 };
+    DBusConnection *peer = NULL;
+
+    dbus_server_set_new_connection_function(server, server_new_connection, &peer, NULL);
+    if (!dbus_server_set_watch_functions(server, server_add_watch, server_remove_watch,
+                                         NULL, &watches, NULL)) {
+        fprintf(stderr, "Failed to set D-Bus server watch functions\n");
+        return NULL;
+    }
+
+    while (!peer) {
+        // Rebuilt every time: handling a watch may add, remove or toggle others
+        struct pollfd pfds[MAX_WATCHES];
+        DBusWatch *polled[MAX_WATCHES];
+        int n = 0;
+        for (int i = 0; i < watches.n; i++) {
+            if (!dbus_watch_get_enabled(watches.w[i])) continue;
+            unsigned flags = dbus_watch_get_flags(watches.w[i]);
+            pfds[n] = (struct pollfd){ .fd = dbus_watch_get_unix_fd(watches.w[i]) };
+            if (flags & DBUS_WATCH_READABLE) pfds[n].events |= POLLIN;
+            if (flags & DBUS_WATCH_WRITABLE) pfds[n].events |= POLLOUT;
+            polled[n++] = watches.w[i];
+        }
+        if (n == 0) {
+            fprintf(stderr, "No enabled D-Bus server watch to wait on\n");
+            break;
+        }
+        if (poll(pfds, n, -1) < 0) {
+            if (errno == EINTR) continue;
+            perror("poll");
+            break;
+        }
+        for (int i = 0; i < n && !peer; i++) {
+            if (!pfds[i].revents || !watch_set_has(&watches, polled[i])) continue;
+            unsigned flags = 0;
+            if (pfds[i].revents & POLLIN) flags |= DBUS_WATCH_READABLE;
+            if (pfds[i].revents & POLLOUT) flags |= DBUS_WATCH_WRITABLE;
+            if (pfds[i].revents & POLLERR) flags |= DBUS_WATCH_ERROR;
+            if (pfds[i].revents & POLLHUP) flags |= DBUS_WATCH_HANGUP;
+            dbus_watch_handle(polled[i], flags);
+        }
+    }
+
+    dbus_server_set_watch_functions(server, NULL, NULL, NULL, NULL, NULL);
+    return peer;
+}
+
+// --codec dbus: the records as one array of structs, field by field
+int record_dbus_append(DBusMessageIter *args, const ipc_record_t *v, uint64_t n) {
+    DBusMessageIter array, st, samples;
+    if (!dbus_message_iter_open_container(args, DBUS_TYPE_ARRAY, RECORD_DBUS_SIGNATURE, &array)) return -1;
+    for (uint64_t i = 0; i < n; i++) {
+        const ipc_record_t *r = &v[i];
+        dbus_bool_t valid = r->valid;
+        double ratio = r->ratio;  // D-Bus has no single precision
+        const double *sp = r->samples;
+        const char *name = r->name, *unit = r->unit;
+
+        if (!dbus_message_iter_open_container(&array, DBUS_TYPE_STRUCT, NULL, &st)) return -1;
+        dbus_message_iter_append_basic(&st, DBUS_TYPE_UINT64, &r->id);
+        dbus_message_iter_append_basic(&st, DBUS_TYPE_INT64, &r->timestamp_ns);
+        dbus_message_iter_append_basic(&st, DBUS_TYPE_UINT32, &r->sequence);
+        dbus_message_iter_append_basic(&st, DBUS_TYPE_INT32, &r->offset);
+        dbus_message_iter_append_basic(&st, DBUS_TYPE_UINT16, &r->port);
+        dbus_message_iter_append_basic(&st, DBUS_TYPE_INT16, &r->delta);
+        dbus_message_iter_append_basic(&st, DBUS_TYPE_BYTE, &r->kind);
+        dbus_message_iter_append_basic(&st, DBUS_TYPE_BYTE, &r->flags);
+        dbus_message_iter_append_basic(&st, DBUS_TYPE_BOOLEAN, &valid);
+        dbus_message_iter_append_basic(&st, DBUS_TYPE_DOUBLE, &r->value);
+        dbus_message_iter_append_basic(&st, DBUS_TYPE_DOUBLE, &ratio);
+        dbus_message_iter_open_container(&st, DBUS_TYPE_ARRAY, "d", &samples);
+        dbus_message_iter_append_fixed_array(&samples, DBUS_TYPE_DOUBLE, &sp, RECORD_SAMPLES);
+        dbus_message_iter_close_container(&st, &samples);
+        dbus_message_iter_append_basic(&st, DBUS_TYPE_STRING, &name);
+        dbus_message_iter_append_basic(&st, DBUS_TYPE_STRING, &unit);
+        if (!dbus_message_iter_close_container(&array, &st)) return -1;
+    }
+    return dbus_message_iter_close_container(args, &array) ? 0 : -1;
+}
+
+// Reads one struct field of the expected type, or fails the record
+int record_dbus_get(DBusMessageIter *st, int type, void *value) {
+    if (dbus_message_iter_get_arg_type(st) != type) return -1;
+    dbus_message_iter_get_basic(st, value);
+    dbus_message_iter_next(st);
+    return 0;
+}
+
+// Reads at most n records back; returns how many, -1 if malformed
+int64_t record_dbus_read(DBusMessageIter *array, ipc_record_t *v, uint64_t n) {
+    DBusMessageIter it, st, samples;
+    uint64_t count = 0;
+
+    dbus_message_iter_recurse(array, &it);
+    while (dbus_message_iter_get_arg_type(&it) == DBUS_TYPE_STRUCT) {
+        if (count == n) return -1;
+        ipc_record_t *r = &v[count++];
+        dbus_bool_t valid;
+        double ratio;
+        const double *sp;
+        const char *name, *unit;
+        int nsamples;
+
+        memset(r, 0, sizeof(*r));
+        dbus_message_iter_recurse(&it, &st);
+        if (record_dbus_get(&st, DBUS_TYPE_UINT64, &r->id) < 0 ||
+            record_dbus_get(&st, DBUS_TYPE_INT64, &r->timestamp_ns) < 0 ||
+            record_dbus_get(&st, DBUS_TYPE_UINT32, &r->sequence) < 0 ||
+            record_dbus_get(&st, DBUS_TYPE_INT32, &r->offset) < 0 ||
+            record_dbus_get(&st, DBUS_TYPE_UINT16, &r->port) < 0 ||
+            record_dbus_get(&st, DBUS_TYPE_INT16, &r->delta) < 0 ||
+            record_dbus_get(&st, DBUS_TYPE_BYTE, &r->kind) < 0 ||
+            record_dbus_get(&st, DBUS_TYPE_BYTE, &r->flags) < 0 ||
+            record_dbus_get(&st, DBUS_TYPE_BOOLEAN, &valid) < 0 ||
+            record_dbus_get(&st, DBUS_TYPE_DOUBLE, &r->value) < 0 ||
+            record_dbus_get(&st, DBUS_TYPE_DOUBLE, &ratio) < 0 ||
+            dbus_message_iter_get_arg_type(&st) != DBUS_TYPE_ARRAY) return -1;
+
+        dbus_message_iter_recurse(&st, &samples);
+        dbus_message_iter_get_fixed_array(&samples, &sp, &nsamples);
+        if (nsamples != RECORD_SAMPLES) return -1;
+        memcpy(r->samples, sp, sizeof(r->samples));
+        dbus_message_iter_next(&st);
+
+        if (record_dbus_get(&st, DBUS_TYPE_STRING, &name) < 0 ||
+            record_dbus_get(&st, DBUS_TYPE_STRING, &unit) < 0 ||
+            strlen(name) >= RECORD_NAME_MAX || strlen(unit) >= RECORD_UNIT_MAX) return -1;
+        strcpy(r->name, name);
+        strcpy(r->unit, unit);
+        r->valid = (uint8_t)valid;
+        r->ratio = (float)ratio;
+        dbus_message_iter_next(&it);
+    }
+    return (int64_t)count;
+}
+
 int main(int argc, char *argv[]) {
-    int size = 0;
+    uint64_t size = 0;
+    int perf = 0;
+    int trace_table = 0;
+    const char *trace_json = NULL;
+    int direct = 0;        // Peer-to-peer connection, no dbus-daemon in the path
+    int private_bus = 0;   // Launch a dbus-daemon just for this run
+    int verify = 0;  // 1: checksum outside the timed region, 2: inside
+    int format = RESULT_TEXT;
+    const char *output = NULL;  // Append records here instead of stdout
+    int codec = -1;        // Structured records (ipcrecord.h); -1 for opaque bytes
 
     static struct option long_options[] = {
         {"size", required_argument, 0, 's'},
+        {"mode", required_argument, 0, 'm'},
+        {"private-bus", no_argument, 0, 'p'},
+        {"perf", no_argument, 0, 'P'},
+        {"trace", no_argument, 0, 'T'},
+        {"trace-json", required_argument, 0, 'J'},
+        {"verify", no_argument, 0, 'V'},
+        {"verify-timed", no_argument, 0, 'I'},
+        {"codec", required_argument, 0, 'C'},
+        {"format", required_argument, 0, 'f'},
+        {"output", required_argument, 0, 'o'},
         {0, 0, 0, 0}
     };
 
     while (1) {
         int option_index = 0;
-        int c = getopt_long(argc, argv, "s:", long_options, &option_index);
+        int c = getopt_long(argc, argv, "s:m:pPTJ:VIC:f:o:", long_options, &option_index);
         if (c == -1) break;
 
         switch (c) {
             case 's':
-                size = atoi(optarg);
+                if (parse_size(optarg, &size) < 0) {
+                    fprintf(stderr, "Invalid size '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'm':
+                if (strcmp(optarg, "bus") == 0) {
+                    direct = 0;
+                } else if (strcmp(optarg, "direct") == 0) {
+                    direct = 1;
+                } else {
+                    fprintf(stderr, "Invalid mode '%s' (expected bus or direct).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'p':
+                private_bus = 1;
+                break;
+            case 'P':
+                perf = 1;
+                break;
+            case 'T':
+                trace_table = 1;
+                break;
+            case 'J':
+                trace_json = optarg;
+                break;
+            case 'V':
+                verify = 1;
+                break;
+            case 'I':
+                verify = 2;
+                break;
+            case 'C':
+                codec = record_codec_parse(optarg, 1);
+                if (codec < 0) {
+                    fprintf(stderr, "Invalid codec '%s' (expected raw, tlv or dbus).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'f':
+                format = result_format_parse(optarg);
+                if (format < 0) {
+                    fprintf(stderr, "Invalid format '%s' (expected text, json or csv).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'o':
+                output = optarg;
                 break;
             default:
-                fprintf(stderr, "Usage: %s --size NUMBER\n", argv[0]);
+                fprintf(stderr, "Usage: %s --size NUMBER [--mode bus|direct] [--private-bus] [--perf] [--trace] [--trace-json FILE] [--verify|--verify-timed] [--codec raw|tlv|dbus] [--format text|json|csv] [--output FILE]\n", argv[0]);
                 return EXIT_FAILURE;
         }
     }
 
-    if (size <= 0) {
+    result_redirect_text(format, output);
+
+    if (size == 0) {
         fprintf(stderr, "Invalid size specified.\n");
         return EXIT_FAILURE;
     }
 
+    // Records are encoded into the payload, or with --codec dbus into an
+    // array of structs after an empty payload
+    uint64_t nrecords = 0;
+    if (codec >= 0) {
+        nrecords = record_count(size);
+        size = record_max_size(codec, nrecords);
+    }
+
+    // The whole payload travels as one D-Bus byte array
+    if (size > DBUS_MAXIMUM_ARRAY_LENGTH - sizeof(struct timeval)) {
+        fprintf(stderr, "Size too large for one D-Bus array (max %zu bytes).\n",
+                (size_t)DBUS_MAXIMUM_ARRAY_LENGTH - sizeof(struct timeval));
+        return EXIT_FAILURE;
+    }
+
+    if (direct && private_bus) {
+        fprintf(stderr, "--private-bus only applies to --mode bus.\n");
+        return EXIT_FAILURE;
+    }
+
     size_t total_size = sizeof(buf_data_t) + size;
 
     buf_data_t *src = malloc(total_size);
@@ -68,13 +414,62 @@ int main(int argc, char *argv[]) {
     }
 
     src->size = size;
-    for (int i = 0; i < size; i++) {
-        src->data[i] = (uint8_t)i;
+    ipc_record_t *records = NULL;
+    double encode_time = 0;
+    if (codec >= 0) {
+        records = malloc(nrecords * sizeof(ipc_record_t));
+        if (!records) {
+            perror("malloc");
+            free(src);
+            return EXIT_FAILURE;
+        }
+        for (uint64_t i = 0; i < nrecords; i++) record_generate(&records[i], i);
+        memset(src->data, 0, size);   // Time the codec, not first-touch faults
+
+        // Encoded before fork, so the child has the time for its report;
+        // D-Bus arguments can only be encoded into the message itself
+        if (codec == CODEC_DBUS) {
+            src->size = size = 0;
+        } else {
+            uint64_t t0 = lat_now_ns();
+            src->size = size = record_encode(codec, records, nrecords, src->data);
+            encode_time = (lat_now_ns() - t0) / 1e9;
+        }
+    } else {
+        for (uint64_t i = 0; i < size; i++) {
+            src->data[i] = (uint8_t)i;
+        }
+    }
+
+    // Both processes connect to the private daemon through the session address
+    pid_t bus_pid = -1;
+    if (private_bus) {
+        char bus_address[512];
+        bus_pid = launch_private_bus(bus_address, sizeof(bus_address));
+        if (bus_pid < 0) {
+            free(src);
+            return EXIT_FAILURE;
+        }
+        setenv("DBUS_SESSION_BUS_ADDRESS", bus_address, 1);
     }
 
+    char direct_address[64];
+    snprintf(direct_address, sizeof(direct_address), DIRECT_ADDRESS_FMT, (int)getpid());
+
+    // Shared between parent and child, so it must exist before fork
+    ipc_trace_t *trace = NULL;
+    if (trace_table || trace_json) trace = ipc_trace_create();
+
+    // Install before fork so the child's ready signal cannot arrive first
+    signal(SIGUSR1, handle_sigusr1);
+
     pid_t child_pid = fork();
     if (child_pid < 0) {
         perror("fork");
+        if (bus_pid > 0) {
+            kill(bus_pid, SIGTERM);
+            waitpid(bus_pid, NULL, 0);
+        }
         free(src);
         return EXIT_FAILURE;
     }
@@ -84,39 +479,88 @@ int main(int argc, char *argv[]) {
         DBusError err;
         dbus_error_init(&err);
 
-        DBusConnection *conn = dbus_bus_get(DBUS_BUS_SESSION, &err);
-        if (!conn) {
-            fprintf(stderr, "Failed to connect to the D-Bus session bus: %s\n", err.message);
-            dbus_error_free(&err);
-            exit(EXIT_FAILURE);
-        }
+        DBusServer *server = NULL;
+        DBusConnection *conn;
 
-        dbus_bus_request_name(conn, "org.example.DBusTransfer", DBUS_NAME_FLAG_REPLACE_EXISTING, &err);
-        if (dbus_error_is_set(&err)) {
-            fprintf(stderr, "Failed to request name on D-Bus: %s\n", err.message);
-            dbus_error_free(&err);
-            dbus_connection_unref(conn);
-            exit(EXIT_FAILURE);
-        }
+        perf_counters_t pc;
+        if (perf) perf_counters_open(&pc);
+
+        if (direct) {
+            unlink(direct_address + strlen("unix:path="));
+            server = dbus_server_listen(direct_address, &err);
+            if (!server) {
+                fprintf(stderr, "Failed to listen on %s: %s\n", direct_address, err.message);
+                dbus_error_free(&err);
+                exit(EXIT_FAILURE);
+            }
 
-        // Signal parent that we are ready
-        kill(getppid(), SIGUSR1);
+            // Signal parent that we are ready, then wait for it to connect
+            if (perf) perf_counters_start(&pc);
+            kill(getppid(), SIGUSR1);
 
+            conn = accept_peer(server);
+            if (!conn) {
+                fprintf(stderr, "Failed to accept D-Bus peer connection\n");
+                dbus_server_disconnect(server);
+                dbus_server_unref(server);
+                exit(EXIT_FAILURE);
+            }
+        } else {
+            conn = dbus_bus_get(DBUS_BUS_SESSION, &err);
+            if (!conn) {
+                fprintf(stderr, "Failed to connect to the D-Bus session bus: %s\n", err.message);
+                dbus_error_free(&err);
+                exit(EXIT_FAILURE);
+            }
+
+            dbus_bus_request_name(conn, "org.example.DBusTransfer", DBUS_NAME_FLAG_REPLACE_EXISTING, &err);
+            if (dbus_error_is_set(&err)) {
+                fprintf(stderr, "Failed to request name on D-Bus: %s\n", err.message);
+                dbus_error_free(&err);
+                dbus_connection_unref(conn);
+                exit(EXIT_FAILURE);
+            }
+
+            // Signal parent that we are ready
+            if (perf) perf_counters_start(&pc);
+            kill(getppid(), SIGUSR1);
+        }
+
+        int ok = 1;
         while (1) {
             dbus_connection_read_write(conn, 100);
             DBusMessage *msg = dbus_connection_pop_message(conn);
             if (!msg) continue;
+            ipc_trace_mark(trace, IPC_TRACE_CHILD, "message dispatched");
 
             if (dbus_message_is_method_call(msg, "org.example.DBusTransfer", "TransferData")) {
-                DBusMessageIter args;
+                DBusMessageIter args, recs;
                 dbus_message_iter_init(msg, &args);
 
-                uint32_t received_size = 0;
+                if (codec == CODEC_DBUS) {
+                    if (dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_ARRAY) {
+                        fprintf(stderr, "Child: Expected record array\n");
+                        dbus_message_unref(msg);
+                        continue;
+                    }
+                    recs = args;
+                    dbus_message_iter_next(&args);
+                    if (dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_DOUBLE) {
+                        fprintf(stderr, "Child: Expected encode time\n");
+                        dbus_message_unref(msg);
+                        continue;
+                    }
+                    dbus_message_iter_get_basic(&args, &encode_time);
+                    dbus_message_iter_next(&args);
+                }
+
+                uint64_t received_size = 0;
+                uint32_t sent_crc = 0;
                 const uint8_t *data_ptr;
                 int array_len = 0;
 
-                if (dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_UINT32) {
-                    fprintf(stderr, "Child: Expected uint32_t\n");
+                if (dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_UINT64) {
+                    fprintf(stderr, "Child: Expected uint64_t\n");
                     dbus_message_unref(msg);
                     continue;
                 }
@@ -124,6 +568,15 @@ int main(int argc, char *argv[]) {
                 dbus_message_iter_get_basic(&args, &received_size);
                 dbus_message_iter_next(&args);
 
+                if (dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_UINT32) {
+                    fprintf(stderr, "Child: Expected uint32_t checksum\n");
+                    dbus_message_unref(msg);
+                    continue;
+                }
+
+                dbus_message_iter_get_basic(&args, &sent_crc);
+                dbus_message_iter_next(&args);
+
                 if (dbus_message_iter_get_arg_type(&args) != DBUS_TYPE_ARRAY) {
                     fprintf(stderr, "Child: Expected byte array\n");
                     dbus_message_unref(msg);
@@ -133,18 +586,25 @@ int main(int argc, char *argv[]) {
                 DBusMessageIter sub_iter;
                 dbus_message_iter_recurse(&args, &sub_iter);
                 dbus_message_iter_get_fixed_array(&sub_iter, &data_ptr, &array_len);
+                ipc_trace_mark(trace, IPC_TRACE_CHILD, "demarshalled");
 
-                if (array_len < sizeof(struct timeval)) {
-                    fprintf(stderr, "Child: Incomplete timing info\n");
+                if (array_len != sizeof(struct timeval) + received_size) {
+                    fprintf(stderr, "Child: Incomplete payload\n");
                     dbus_message_unref(msg);
                     continue;
                 }
 
+                uint32_t crc = 0;
+                if (verify == 2) crc = crc32c(0, data_ptr + sizeof(struct timeval), received_size);
+
                 struct timeval start;
                 memcpy(&start, data_ptr, sizeof(struct timeval));
 
                 struct timeval end;
                 gettimeofday(&end, NULL);
+                if (perf) perf_counters_stop(&pc);
+
+                if (verify == 1) crc = crc32c(0, data_ptr + sizeof(struct timeval), received_size);
 
                 long sec = end.tv_sec - start.tv_sec;
                 long usec = end.tv_usec - start.tv_usec;
@@ -153,13 +613,60 @@ int main(int argc, char *argv[]) {
                     usec += 1000000;
                 }
 
+                // What went over the wire for --codec dbus is the message itself
+                uint64_t wire_size = received_size;
+                if (codec == CODEC_DBUS) {
+                    char *marshalled;
+                    int len;
+                    if (dbus_message_marshal(msg, &marshalled, &len)) {
+                        wire_size = len;
+                        dbus_free(marshalled);
+                    }
+                }
+
                 double elapsed = sec + usec / 1e6;
-                double bps = elapsed > 0 ? (received_size / elapsed) : 0;
+                double bps = elapsed > 0 ? (wire_size / elapsed) : 0;
                 double mbps = bps / 1e6;
 
+                printf("[Child] D-Bus Path:   %s\n", direct ? "direct" : (private_bus ? "private bus" : "session bus"));
                 printf("[Child] Elapsed Time: %.6f seconds\n", elapsed);
-                printf("[Child] Transferred:  %u bytes\n", received_size);
+                printf("[Child] Transferred:  %" PRIu64 " bytes\n", wire_size);
                 printf("[Child] Throughput:   %.2f bytes/sec (%.2f MB/sec)\n", bps, mbps);
+                result_print_peak("[Child] ", bps);
+                if (perf) perf_counters_print(&pc, "[Child] ");
+                ipc_trace_mark(trace, IPC_TRACE_CHILD, "post-processing");
+
+                if (verify) ok = crc32c_report("[Child] ", sent_crc, crc) == 0;
+
+                char label[32];
+                snprintf(label, sizeof(label), "%s", direct ? "dbus-direct" : (private_bus ? "dbus-private" : "dbus-bus"));
+                ipc_codec_t cd = { NULL };
+                if (codec >= 0) {
+                    ipc_record_t *decoded = malloc(nrecords * sizeof(ipc_record_t));
+                    if (!decoded) {
+                        perror("Child malloc");
+                        exit(EXIT_FAILURE);
+                    }
+                    memset(decoded, 0, nrecords * sizeof(ipc_record_t));
+                    uint64_t t0 = lat_now_ns();
+                    int64_t got = codec == CODEC_DBUS
+                        ? record_dbus_read(&recs, decoded, nrecords)
+                        : record_decode(codec, data_ptr + sizeof(struct timeval), received_size, decoded, nrecords);
+                    double decode_time = (lat_now_ns() - t0) / 1e9;
+
+                    record_print("[Child] ", record_codec_names[codec], nrecords, wire_size, encode_time, elapsed, decode_time);
+                    if (got != (int64_t)nrecords || record_check(decoded, nrecords) != 0) {
+                        printf("[Child] Decoded:      FAILED\n");
+                        ok = 0;
+                    }
+                    free(decoded);
+
+                    cd = (ipc_codec_t){ record_codec_names[codec], nrecords, encode_time, decode_time };
+                    snprintf(label + strlen(label), sizeof(label) - strlen(label), "-%s", record_codec_names[codec]);
+                }
+
+                ipc_result_t result = { label, wire_size, elapsed, verify ? ok : -1, NULL, NULL, codec >= 0 ? &cd : NULL };
+                result_emit(format, output, &result);
 
                 dbus_message_unref(msg);
                 break; // One-shot transfer; exit after report
@@ -168,45 +675,89 @@ int main(int argc, char *argv[]) {
             dbus_message_unref(msg);
         }
 
+        if (perf) perf_counters_close(&pc);
+        if (server) {
+            dbus_connection_close(conn);
+            dbus_server_disconnect(server);
+            dbus_server_unref(server);
+        }
         dbus_connection_unref(conn);
-        exit(EXIT_SUCCESS);
+        exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
     } else {
         // --- Parent Process (D-Bus Client) ---
-        signal(SIGUSR1, handle_sigusr1);
         while (!sigusr1_received) pause();
 
         DBusError err;
         dbus_error_init(&err);
 
-        DBusConnection *conn = dbus_bus_get(DBUS_BUS_SESSION, &err);
+        DBusConnection *conn;
+        if (direct) {
+            conn = dbus_connection_open_private(direct_address, &err);
+        } else {
+            conn = dbus_bus_get(DBUS_BUS_SESSION, &err);
+        }
         if (!conn) {
             fprintf(stderr, "Parent: D-Bus connection failed: %s\n", err.message);
             dbus_error_free(&err);
+            stop_children(child_pid, bus_pid);
             free(src);
             return EXIT_FAILURE;
         }
 
+        // A peer-to-peer connection has no bus to route by name
         DBusMessage *msg = dbus_message_new_method_call(
-            "org.example.DBusTransfer",
+            direct ? NULL : "org.example.DBusTransfer",
             "/org/example/DBusTransfer",
             "org.example.DBusTransfer",
             "TransferData"
         );
         if (!msg) {
             fprintf(stderr, "Parent: Failed to create message\n");
+            if (direct) dbus_connection_close(conn);
             dbus_connection_unref(conn);
+            stop_children(child_pid, bus_pid);
             free(src);
             return EXIT_FAILURE;
         }
 
+        perf_counters_t pc;
+        if (perf) perf_counters_open(&pc);
+
+        if (verify == 1) src->crc = crc32c(0, src->data, size);
+
+        DBusMessageIter args;
+        dbus_message_iter_init_append(msg, &args);
+        if (codec == CODEC_DBUS) {
+            uint64_t t0 = lat_now_ns();
+            int rc = record_dbus_append(&args, records, nrecords);
+            encode_time = (lat_now_ns() - t0) / 1e9;
+            if (rc < 0 || !dbus_message_iter_append_basic(&args, DBUS_TYPE_DOUBLE, &encode_time)) {
+                // The child would reject the message and wait for another
+                fprintf(stderr, "Parent: Failed to marshal records\n");
+                dbus_message_unref(msg);
+                if (direct) dbus_connection_close(conn);
+                dbus_connection_unref(conn);
+                stop_children(child_pid, bus_pid);
+                if (perf) perf_counters_close(&pc);
+                free(records);
+                free(src);
+                return EXIT_FAILURE;
+            }
+        }
+
         // Prepare payload: [start_time | data[]]
+        if (perf) perf_counters_start(&pc);
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "pre-send");
         gettimeofday(&src->start, NULL);
+        if (verify == 2) src->crc = crc32c(0, src->data, size);
         size_t payload_size = sizeof(struct timeval) + size;
         uint8_t *payload = malloc(payload_size);
         if (!payload) {
             perror("malloc");
             dbus_message_unref(msg);
+            if (direct) dbus_connection_close(conn);
             dbus_connection_unref(conn);
+            stop_children(child_pid, bus_pid);
             free(src);
             return EXIT_FAILURE;
         }
@@ -214,26 +765,53 @@ int main(int argc, char *argv[]) {
         memcpy(payload, &src->start, sizeof(struct timeval));
         memcpy(payload + sizeof(struct timeval), src->data, size);
 
-        DBusMessageIter args;
-        dbus_message_iter_init_append(msg, &args);
-        dbus_message_iter_append_basic(&args, DBUS_TYPE_UINT32, &src->size);
+        dbus_message_iter_append_basic(&args, DBUS_TYPE_UINT64, &src->size);
+        dbus_message_iter_append_basic(&args, DBUS_TYPE_UINT32, &src->crc);
 
 	DBusMessageIter array_iter;
 	dbus_message_iter_open_container(&args, DBUS_TYPE_ARRAY, "y", &array_iter);
 	dbus_message_iter_append_fixed_array(&array_iter, DBUS_TYPE_BYTE, &payload, payload_size);
 	dbus_message_iter_close_container(&args, &array_iter);
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "marshalled");
 
         if (!dbus_connection_send(conn, msg, NULL)) {
             fprintf(stderr, "Parent: Failed to send message\n");
         }
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "send return");
 
         dbus_connection_flush(conn);
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "flushed");
+        if (perf) perf_counters_stop(&pc);
         dbus_message_unref(msg);
-        dbus_connection_unref(conn);
 
         free(payload);
+        free(records);
         free(src);
-        wait(NULL);
+        int status;
+        waitpid(child_pid, &status, 0);
+
+        if (perf) {
+            perf_counters_print(&pc, "[Parent] ");
+            perf_counters_close(&pc);
+        }
+
+        if (trace_table) ipc_trace_print_table(trace);
+        if (trace_json) ipc_trace_write_chrome(trace, trace_json);
+        ipc_trace_destroy(trace);
+
+        // Keep a private connection open until the child has read the message
+        if (direct) {
+            dbus_connection_close(conn);
+            unlink(direct_address + strlen("unix:path="));
+        }
+        dbus_connection_unref(conn);
+
+        if (bus_pid > 0) {
+            kill(bus_pid, SIGTERM);
+            waitpid(bus_pid, NULL, 0);
+        }
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) return EXIT_FAILURE;
     }
 
     return EXIT_SUCCESS;
@@ -0,0 +1,631 @@
+//
+// epollmemcpy.c
+//
+// For questions/support: norman.mcentire@gmail.com
+//
+// To build: gcc -Wall -O2 epollmemcpy.c -o epollmemcpy -lpthread
+//
+// Connection scaling for a TCP receiver built on edge-triggered epoll.
+// For each connection count in --conns LIST the parent opens that many
+// loopback connections and keeps one --size message in flight on each:
+// the child acknowledges every message with one byte and the next one goes
+// out on the same connection, until --count messages have been sent in
+// total.  The child serves every connection from --loops event loops
+// (threads; with more than one, loop i is pinned to CPU i):
+//
+//   default      one listening socket shared by all loops, registered with
+//                EPOLLEXCLUSIVE so a new connection wakes a single loop
+//   --reuseport  a SO_REUSEPORT listener per loop; the kernel spreads the
+//                connections over them by hash
+//
+// For each step the child reports messages/sec, the latency from the
+// sender's sendmsg() to the read() that completed the message, and how
+// evenly the connections landed on the loops.  --loops 0 runs one loop per
+// online CPU.  LIST is a comma list or A:B doubling, e.g. --conns 1:1024.
+// The sender is a single epoll loop too, so with many receiver loops it
+// can become the limit; compare its CPU time with the child's.
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <poll.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include "crc32c.h"
+#include "ipcstream.h"
+#include "ipcresult.h"
+#include "ipclat.h"
+
+#define EPOLL_PORT 54322
+#define MAX_STEPS 64
+#define MAX_LOOPS 256
+#define MAX_EVENTS 256
+#define MAX_CONNS 1000000   // Per step; the descriptor limit usually binds first
+
+// In front of every message, so the receiver can split reads
+typedef struct {
+    uint32_t len;          // Payload bytes that follow
+    uint32_t seq;          // Per connection
+    uint64_t sent_ns;      // CLOCK_MONOTONIC at the sendmsg() carrying it
+} frame_hdr_t;
+
+// Receiver state of one connection (or of a listening socket)
+typedef struct {
+    int fd;
+    int listener;
+    uint32_t seq;          // Next expected
+    size_t have;           // Bytes of the current frame read so far
+    uint8_t buf[];         // One frame
+} conn_t;
+
+// One event loop.  Only its own thread writes the counters while a step
+// runs; the main thread reads them once n reaches the step's count and
+// resets them between steps, while the sender is idle.
+typedef struct {
+    pthread_t tid;
+    int cpu;               // -1 when not pinned
+    int epfd;
+    uint64_t size;
+    int verify;
+    uint32_t expected;
+    double *lat;           // count entries
+    uint64_t n;            // Messages completed this step
+    uint64_t first;        // Earliest sent_ns this step
+    uint64_t last;         // Latest completion this step
+    uint64_t mismatches;   // Bad CRCs this step, counted before n
+    int conns;             // Connections accepted this step
+    int failed;
+} loop_t;
+
+volatile sig_atomic_t sigusr1_received = 0;
+
+void handle_sigusr1(int sig) {
+    sigusr1_received = 1;
+}
+
+int tcp_listener(int reuseport) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (fd < 0) {
+        perror("Child socket");
+        return -1;
+    }
+    int one = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (reuseport && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0) {
+        perror("Child SO_REUSEPORT");
+        close(fd);
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(EPOLL_PORT);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        perror("Child bind/listen");
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Edge triggered: accept until the backlog is empty
+void accept_all(loop_t *l, int lfd) {
+    size_t frame = sizeof(frame_hdr_t) + l->size;
+    while (1) {
+        int fd = accept4(lfd, NULL, NULL, SOCK_NONBLOCK);
+        if (fd < 0) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                perror("Child accept");
+                l->failed = 1;
+            }
+            if (errno != EINTR) return;
+            continue;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        conn_t *c = malloc(sizeof(conn_t) + frame);
+        if (!c) {
+            perror("Child malloc");
+            close(fd);
+            l->failed = 1;
+            return;
+        }
+        c->fd = fd;
+        c->listener = 0;
+        c->seq = 0;
+        c->have = 0;
+        // Data that arrived before this reports an event straight away
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP | EPOLLET, .data.ptr = c };
+        if (epoll_ctl(l->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+            perror("Child epoll_ctl");
+            close(fd);
+            free(c);
+            l->failed = 1;
+            return;
+        }
+        l->conns++;
+    }
+}
+
+void drop(conn_t *c) {
+    close(c->fd);   // Also removes it from the epoll set
+    free(c);
+}
+
+// Edge triggered: read until EAGAIN, acknowledging each complete frame
+void serve(loop_t *l, conn_t *c) {
+    size_t frame = sizeof(frame_hdr_t) + l->size;
+    while (1) {
+        ssize_t r = read(c->fd, c->buf + c->have, frame - c->have);
+        if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) {
+            drop(c);   // The sender closed it at the end of a step
+            return;
+        }
+        c->have += r;
+        if (c->have < frame) continue;
+
+        uint64_t now = lat_now_ns();
+        frame_hdr_t hdr;
+        memcpy(&hdr, c->buf, sizeof(hdr));
+        c->have = 0;
+        if (hdr.len != l->size || hdr.seq != c->seq) {
+            fprintf(stderr, "Child: Bad frame (len %u, seq %u, expected %u)\n", hdr.len, hdr.seq, c->seq);
+            l->failed = 1;
+            drop(c);
+            return;
+        }
+        c->seq++;
+
+        uint64_t n = l->n;
+        if (n == 0 || hdr.sent_ns < l->first) l->first = hdr.sent_ns;
+        if (now > l->last) l->last = now;
+        l->lat[n] = (double)(int64_t)(now - hdr.sent_ns) / 1e9;
+
+        char ack = 1;
+        int acked = send(c->fd, &ack, 1, MSG_NOSIGNAL) == 1;
+
+        // After the acknowledgement, so it is not part of the round trip, but
+        // before n counts the frame, so the main thread sees it in this step
+        if (l->verify && crc32c(0, c->buf + sizeof(hdr), l->size) != l->expected) l->mismatches++;
+        __atomic_store_n(&l->n, n + 1, __ATOMIC_RELEASE);
+        if (!acked) {
+            drop(c);
+            return;
+        }
+    }
+}
+
+void *event_loop(void *arg) {
+    loop_t *l = arg;
+    struct epoll_event events[MAX_EVENTS];
+    while (1) {
+        int n = epoll_wait(l->epfd, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("Child epoll_wait");
+            l->failed = 1;
+            return NULL;
+        }
+        for (int i = 0; i < n; i++) {
+            conn_t *c = events[i].data.ptr;
+            if (!c) return NULL;   // The stop eventfd
+            if (c->listener) accept_all(l, c->fd);
+            else serve(l, c);
+        }
+    }
+}
+
+int full_sendmsg(int fd, struct iovec *iov, int cnt) {
+    while (cnt > 0) {
+        struct msghdr msg = { .msg_iov = iov, .msg_iovlen = cnt };
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n <= 0) return -1;
+        while (cnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            cnt--;
+        }
+        if (cnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+int send_frame(int fd, uint32_t seq, const uint8_t *payload, uint64_t size) {
+    frame_hdr_t hdr = { (uint32_t)size, seq, lat_now_ns() };
+    struct iovec iov[2] = { { &hdr, sizeof(hdr) }, { (void *)payload, size } };
+    return full_sendmsg(fd, iov, 2);
+}
+
+// One step: conns connections with one message in flight on each, count
+// messages in total, then close them all
+int drive_step(int conns, uint64_t count, const uint8_t *payload, uint64_t size) {
+    int *fds = malloc(conns * sizeof(int));
+    uint32_t *seq = calloc(conns, sizeof(uint32_t));
+    int ep = epoll_create1(0);
+    if (!fds || !seq || ep < 0) {
+        perror("Parent setup");
+        free(fds);
+        free(seq);
+        if (ep >= 0) close(ep);
+        return -1;
+    }
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(EPOLL_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int rc = 0, opened = 0;
+    for (; opened < conns; opened++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+            fprintf(stderr, "Parent: Connection %d: %s\n", opened, strerror(errno));
+            if (fd >= 0) close(fd);
+            rc = -1;
+            break;
+        }
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        struct epoll_event ev = { .events = EPOLLIN, .data.u32 = opened };
+        epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+        fds[opened] = fd;
+    }
+
+    uint64_t sent = 0, acked = 0;
+    for (int i = 0; rc == 0 && i < conns && sent < count; i++, sent++) {
+        if (send_frame(fds[i], seq[i]++, payload, size) < 0) rc = -1;
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    while (rc == 0 && acked < sent) {
+        int n = epoll_wait(ep, events, MAX_EVENTS, -1);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) {
+            perror("Parent epoll_wait");
+            rc = -1;
+            break;
+        }
+        for (int e = 0; e < n && rc == 0; e++) {
+            int i = events[e].data.u32;
+            char acks[64];
+            ssize_t r = read(fds[i], acks, sizeof(acks));
+            if (r <= 0) {
+                fprintf(stderr, "Parent: Connection %d closed by the receiver\n", i);
+                rc = -1;
+                break;
+            }
+            acked += r;
+            for (ssize_t k = 0; k < r && sent < count; k++, sent++) {
+                if (send_frame(fds[i], seq[i]++, payload, size) < 0) rc = -1;
+            }
+        }
+    }
+
+    for (int i = 0; i < opened; i++) close(fds[i]);
+    close(ep);
+    free(fds);
+    free(seq);
+    return rc;
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t size = 0;
+    double steps[MAX_STEPS];
+    int nsteps = lat_parse_steps("1:1024", steps, MAX_STEPS);
+    uint64_t count = 100000;  // Messages per step, over all connections
+    int nloops = 1;
+    int reuseport = 0;
+    int verify = 0;
+    int format = RESULT_TEXT;
+    const char *output = NULL;  // Append records here instead of stdout
+
+    static struct option long_options[] = {
+        {"size", required_argument, 0, 's'},
+        {"conns", required_argument, 0, 'n'},
+        {"count", required_argument, 0, 'c'},
+        {"loops", required_argument, 0, 'l'},
+        {"reuseport", no_argument, 0, 'R'},
+        {"verify", no_argument, 0, 'V'},
+        {"format", required_argument, 0, 'f'},
+        {"output", required_argument, 0, 'o'},
+        {0, 0, 0, 0}
+    };
+
+    while (1) {
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "s:n:c:l:RVf:o:", long_options, &option_index);
+        if (c == -1) break;
+
+        switch (c) {
+            case 's':
+                if (parse_size(optarg, &size) < 0) {
+                    fprintf(stderr, "Invalid size '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'n':
+                nsteps = lat_parse_steps(optarg, steps, MAX_STEPS);
+                for (int i = 0; i < nsteps; i++) {
+                    if (steps[i] < 1 || steps[i] > MAX_CONNS || steps[i] != (int)steps[i]) nsteps = -1;
+                }
+                if (nsteps <= 0) {
+                    fprintf(stderr, "Invalid connection counts '%s' (1 to %d, e.g. 1,64,512 or 1:1024).\n", optarg, MAX_CONNS);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'c':
+                if (parse_size(optarg, &count) < 0 || count == 0) {
+                    fprintf(stderr, "Invalid count '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'l':
+                nloops = atoi(optarg);
+                if (nloops == 0) nloops = (int)sysconf(_SC_NPROCESSORS_ONLN);
+                if (nloops < 1 || nloops > MAX_LOOPS) {
+                    fprintf(stderr, "Invalid loop count '%s' (1 to %d, 0 for one per CPU).\n", optarg, MAX_LOOPS);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'R':
+                reuseport = 1;
+                break;
+            case 'V':
+                verify = 1;
+                break;
+            case 'f':
+                format = result_format_parse(optarg);
+                if (format < 0) {
+                    fprintf(stderr, "Invalid format '%s' (expected text, json or csv).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s --size NUMBER [--conns LIST] [--count N] [--loops N] [--reuseport] [--verify] [--format text|json|csv] [--output FILE]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    result_redirect_text(format, output);
+
+    if (size == 0 || size > UINT32_MAX) {
+        fprintf(stderr, "Invalid size specified.\n");
+        return EXIT_FAILURE;
+    }
+
+    // Both ends hold one descriptor per connection, plus the previous
+    // step's connections while they are being torn down
+    int max_conns = 0;
+    for (int i = 0; i < nsteps; i++) {
+        if (steps[i] > max_conns) max_conns = (int)steps[i];
+    }
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+    if (rl.rlim_cur != RLIM_INFINITY && (rlim_t)2 * max_conns + 64 > rl.rlim_cur) {
+        fprintf(stderr, "%d connections need more than the %lu descriptors allowed (ulimit -n).\n",
+                max_conns, (unsigned long)rl.rlim_cur);
+        return EXIT_FAILURE;
+    }
+
+    uint8_t *payload = malloc(size);
+    if (!payload) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    for (uint64_t i = 0; i < size; i++) {
+        payload[i] = (uint8_t)i;
+    }
+
+    // Step control: the child acknowledges each step once its results are
+    // out, and sees the parent exit as end of file
+    int ctl[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, ctl) < 0) {
+        perror("socketpair");
+        free(payload);
+        return EXIT_FAILURE;
+    }
+
+    // Install before fork so the child's ready signal cannot arrive first
+    signal(SIGUSR1, handle_sigusr1);
+
+    pid_t child_pid = fork();
+    if (child_pid < 0) {
+        perror("fork");
+        free(payload);
+        return EXIT_FAILURE;
+    }
+
+    if (child_pid == 0) {
+        // --- Child Process ---
+        close(ctl[0]);
+        int fd = ctl[1];
+
+        static loop_t loops[MAX_LOOPS];
+        static conn_t listeners[MAX_LOOPS];
+        uint32_t expected = verify ? crc32c(0, payload, size) : 0;
+        int stop_fd = eventfd(0, 0);
+        int shared_fd = reuseport ? -1 : tcp_listener(0);
+        if (stop_fd < 0 || (!reuseport && shared_fd < 0)) exit(EXIT_FAILURE);
+
+        long ncpus = sysconf(_SC_NPROCESSORS_ONLN);
+        for (int i = 0; i < nloops; i++) {
+            loop_t *l = &loops[i];
+            l->cpu = nloops > 1 ? i % (int)ncpus : -1;
+            l->size = size;
+            l->verify = verify;
+            l->expected = expected;
+            l->lat = malloc(count * sizeof(double));
+            l->epfd = epoll_create1(0);
+            int lfd = reuseport ? tcp_listener(1) : shared_fd;
+            if (!l->lat || l->epfd < 0 || lfd < 0) {
+                perror("Child loop setup");
+                exit(EXIT_FAILURE);
+            }
+
+            listeners[i].fd = lfd;
+            listeners[i].listener = 1;
+            struct epoll_event ev = { .events = EPOLLIN | EPOLLET, .data.ptr = &listeners[i] };
+            if (!reuseport) ev.events |= EPOLLEXCLUSIVE;
+            struct epoll_event stop = { .events = EPOLLIN, .data.ptr = NULL };
+            if (epoll_ctl(l->epfd, EPOLL_CTL_ADD, lfd, &ev) < 0 ||
+                epoll_ctl(l->epfd, EPOLL_CTL_ADD, stop_fd, &stop) < 0) {
+                perror("Child epoll_ctl");
+                exit(EXIT_FAILURE);
+            }
+
+            pthread_attr_t attr;
+            pthread_attr_init(&attr);
+            if (l->cpu >= 0) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(l->cpu, &set);
+                pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+            }
+            int rc = pthread_create(&l->tid, &attr, event_loop, l);
+            pthread_attr_destroy(&attr);
+            if (rc != 0) {
+                fprintf(stderr, "pthread_create: %s\n", strerror(rc));
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        // Notify parent
+        kill(getppid(), SIGUSR1);
+
+        double *all = malloc(count * sizeof(double));
+        if (!all) {
+            perror("Child malloc");
+            exit(EXIT_FAILURE);
+        }
+
+        printf("[Child] Event loops:  %d (%s), %" PRIu64 " messages of %" PRIu64 " bytes per step\n",
+               nloops, reuseport ? "SO_REUSEPORT listener each" : "shared listener", count, size);
+        lat_print_header("[Child] ", "Conns");
+
+        int ok = 1;
+        uint64_t mismatches = 0;
+        for (int s = 0; s < nsteps && ok; s++) {
+            // Wait for the step's last message; the parent exiting early
+            // shows up as end of file on the control socket
+            uint64_t done = 0;
+            while (done < count) {
+                struct pollfd pfd = { .fd = fd, .events = POLLIN };
+                if (poll(&pfd, 1, 1) > 0) {
+                    ok = 0;
+                    break;
+                }
+                done = 0;
+                for (int i = 0; i < nloops; i++) {
+                    done += __atomic_load_n(&loops[i].n, __ATOMIC_ACQUIRE);
+                    if (loops[i].failed) ok = 0;
+                }
+                if (!ok) break;
+            }
+            if (!ok) break;
+
+            uint64_t first = UINT64_MAX, last = 0, n = 0;
+            int min_conns = INT32_MAX, max_conns = 0;
+            for (int i = 0; i < nloops; i++) {
+                loop_t *l = &loops[i];
+                memcpy(all + n, l->lat, l->n * sizeof(double));
+                n += l->n;
+                if (l->n && l->first < first) first = l->first;
+                if (l->last > last) last = l->last;
+                if (l->conns < min_conns) min_conns = l->conns;
+                if (l->conns > max_conns) max_conns = l->conns;
+            }
+
+            ipc_latency_t lat = { 0 };
+            lat_summarize(all, n, &lat);
+            double span = last > first ? (last - first) / 1e9 : 0;
+            lat_print("[Child] ", steps[s], span > 0 ? n / span : 0, &lat);
+            printf("[Child]              %.2f MB/sec, %d to %d connections per loop\n",
+                   span > 0 ? n * size / span / 1e6 : 0, min_conns, max_conns);
+
+            // elapsed is the cost per message, so bytes_per_sec is the payload throughput
+            uint64_t bad = 0;
+            for (int i = 0; i < nloops; i++) bad += loops[i].mismatches;
+            mismatches += bad;
+            char label[64];
+            snprintf(label, sizeof(label), "epoll%s-%d", reuseport ? "-reuseport" : "", (int)steps[s]);
+            ipc_result_t result = { label, size, span / n, verify ? bad == 0 : -1, &lat };
+            result_emit(format, output, &result);
+            fflush(stdout);
+
+            // The sender waits for the acknowledgement, so nothing runs now
+            for (int i = 0; i < nloops; i++) {
+                loops[i].n = loops[i].first = loops[i].last = loops[i].mismatches = 0;
+                loops[i].conns = 0;
+            }
+            char ack = 1;
+            if (write(fd, &ack, 1) != 1) ok = 0;
+        }
+
+        uint64_t one = 1;
+        if (write(stop_fd, &one, sizeof(one)) != sizeof(one)) ok = 0;
+        for (int i = 0; i < nloops; i++) {
+            pthread_join(loops[i].tid, NULL);
+            mismatches += loops[i].mismatches;
+            if (loops[i].failed) ok = 0;
+        }
+
+        if (verify) {
+            if (mismatches) printf("[Child] Verified:     FAILED (%" PRIu64 " messages with a bad crc32c)\n", mismatches);
+            else printf("[Child] Verified:     OK (crc32c 0x%08x, %s)\n", expected, crc32c_impl());
+            if (mismatches) ok = 0;
+        }
+
+        exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+    } else {
+        // --- Parent Process ---
+        close(ctl[1]);
+        int fd = ctl[0];
+        while (!sigusr1_received) pause();
+
+        int failed = 0;
+        for (int s = 0; s < nsteps && !failed; s++) {
+            char ack;
+            failed = drive_step((int)steps[s], count, payload, size) < 0 || read(fd, &ack, 1) != 1;
+        }
+
+        close(fd);
+        int status;
+        wait(&status);
+        free(payload);
+
+        if (failed || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
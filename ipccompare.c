@@ -0,0 +1,236 @@
+//
+// ipccompare.c
+//
+// For questions/support: norman.mcentire@gmail.com
+//
+// To build: gcc -Wall ipccompare.c -o ipccompare -lm
+//
+// Compares two result files written by the tools with --format json|csv
+// (e.g. before and after a kernel or library upgrade) and flags
+// statistically significant throughput changes per transport and size.
+// Runs that differ in --pattern, --align or --codec are kept apart, with
+// the variant appended to the transport name (see result_group_name()).
+//
+// For each transport/size present in both files it reports the median
+// throughput of each side, the Hodges-Lehmann shift with its
+// distribution-free confidence interval, and the two-sided Mann-Whitney U
+// p-value (normal approximation with tie correction).  A group is a
+// REGRESSION when p < alpha and the shift is below -threshold percent.
+//
+// Exit status: 0 no regressions, 1 at least one regression, 2 error.
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include "ipcresult.h"
+
+#define MIN_SAMPLES 3
+
+int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+double median(double *v, size_t n) {
+    qsort(v, n, sizeof(double), cmp_double);
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+// Two-sided standard normal quantile: z with P(|Z| > z) = alpha
+double normal_quantile(double alpha) {
+    double lo = 0, hi = 10;
+    for (int i = 0; i < 100; i++) {
+        double mid = (lo + hi) / 2;
+        if (erfc(mid / M_SQRT2) > alpha) lo = mid;
+        else hi = mid;
+    }
+    return (lo + hi) / 2;
+}
+
+typedef struct {
+    double value;
+    int group;
+} ranked_t;
+
+int cmp_ranked(const void *a, const void *b) {
+    return cmp_double(&((const ranked_t *)a)->value, &((const ranked_t *)b)->value);
+}
+
+// Two-sided Mann-Whitney U p-value for samples x (n1) and y (n2)
+double mann_whitney_p(const double *x, size_t n1, const double *y, size_t n2) {
+    size_t n = n1 + n2;
+    ranked_t *all = malloc(n * sizeof(*all));
+    if (!all) return NAN;
+
+    for (size_t i = 0; i < n1; i++) all[i] = (ranked_t){ x[i], 0 };
+    for (size_t i = 0; i < n2; i++) all[n1 + i] = (ranked_t){ y[i], 1 };
+    qsort(all, n, sizeof(*all), cmp_ranked);
+
+    double r1 = 0, ties = 0;
+    for (size_t i = 0; i < n; ) {
+        size_t j = i;
+        while (j + 1 < n && all[j + 1].value == all[i].value) j++;
+        double rank = (i + j) / 2.0 + 1;  // Average rank of the tie block
+        double t = j - i + 1;
+        ties += t * t * t - t;
+        for (size_t k = i; k <= j; k++) {
+            if (all[k].group == 0) r1 += rank;
+        }
+        i = j + 1;
+    }
+    free(all);
+
+    double u = r1 - n1 * (n1 + 1) / 2.0;
+    double mean = n1 * n2 / 2.0;
+    double var = n1 * n2 / 12.0 * ((n + 1) - ties / ((double)n * (n - 1)));
+    if (var <= 0) return 1.0;
+
+    double diff = fabs(u - mean) - 0.5;  // Continuity correction
+    if (diff < 0) diff = 0;
+    return erfc(diff / sqrt(var) / M_SQRT2);
+}
+
+// Hodges-Lehmann shift (y - x) and its distribution-free confidence interval
+void hodges_lehmann(const double *x, size_t n1, const double *y, size_t n2, double alpha,
+                    double *shift, double *lo, double *hi) {
+    size_t m = n1 * n2;
+    double *d = malloc(m * sizeof(double));
+    if (!d) {
+        *shift = *lo = *hi = NAN;
+        return;
+    }
+
+    for (size_t i = 0; i < n1; i++) {
+        for (size_t j = 0; j < n2; j++) d[i * n2 + j] = y[j] - x[i];
+    }
+    *shift = median(d, m);  // Also sorts d
+
+    // The bounds are the C-th smallest and largest differences, 1-based
+    double z = normal_quantile(alpha);
+    double k = floor(m / 2.0 - z * sqrt(n1 * n2 * (n1 + n2 + 1) / 12.0));
+    if (k < 1) k = 1;
+    *lo = d[(size_t)k - 1];
+    *hi = d[m - (size_t)k];
+    free(d);
+}
+
+// Collects the throughput of one group/size into out; returns the count
+size_t select_group(const result_set_t *set, const char *group, uint64_t size, double *out) {
+    size_t n = 0;
+    for (size_t i = 0; i < set->n; i++) {
+        if (set->v[i].size == size && strcmp(set->v[i].group, group) == 0) {
+            out[n++] = set->v[i].bps;
+        }
+    }
+    return n;
+}
+
+int main(int argc, char *argv[]) {
+    double alpha = 0.05;
+    double threshold = 2.0;  // Percent; smaller significant shifts are reported but not flagged
+
+    static struct option long_options[] = {
+        {"alpha", required_argument, 0, 'a'},
+        {"threshold", required_argument, 0, 't'},
+        {0, 0, 0, 0}
+    };
+
+    while (1) {
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "a:t:", long_options, &option_index);
+        if (c == -1) break;
+
+        switch (c) {
+            case 'a':
+                alpha = atof(optarg);
+                break;
+            case 't':
+                threshold = atof(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s BASELINE CANDIDATE [--alpha P] [--threshold PERCENT]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if (argc - optind != 2 || alpha <= 0 || alpha >= 1 || threshold < 0) {
+        fprintf(stderr, "Usage: %s BASELINE CANDIDATE [--alpha P] [--threshold PERCENT]\n", argv[0]);
+        return 2;
+    }
+
+    result_set_t base = { 0 }, cand = { 0 };
+    if (result_load(argv[optind], &base) < 0 || result_load(argv[optind + 1], &cand) < 0) {
+        return 2;
+    }
+    if (base.n == 0 || cand.n == 0) {
+        fprintf(stderr, "No result records found.\n");
+        return 2;
+    }
+
+    double *x = malloc(base.n * sizeof(double));
+    double *y = malloc(cand.n * sizeof(double));
+    if (!x || !y) {
+        perror("malloc");
+        return 2;
+    }
+
+    printf("%-24s %12s %4s %4s %12s %12s %8s %19s %9s  %s\n",
+           "Transport", "Size", "n_b", "n_c", "Base MB/s", "Cand MB/s",
+           "Shift", "CI", "p", "Verdict");
+
+    int regressions = 0;
+    for (size_t i = 0; i < base.n; i++) {
+        const result_sample_t *g = &base.v[i];
+
+        // Report each group/size once, at its first occurrence
+        int seen = 0;
+        for (size_t k = 0; k < i && !seen; k++) {
+            seen = base.v[k].size == g->size && strcmp(base.v[k].group, g->group) == 0;
+        }
+        if (seen) continue;
+
+        size_t n1 = select_group(&base, g->group, g->size, x);
+        size_t n2 = select_group(&cand, g->group, g->size, y);
+        if (n2 == 0) {
+            printf("%-24s %12llu %4zu %4zu %12s %12s %8s %19s %9s  %s\n", g->group,
+                   (unsigned long long)g->size, n1, n2, "", "", "", "", "", "missing in candidate");
+            continue;
+        }
+
+        double shift, lo, hi;
+        double p = mann_whitney_p(x, n1, y, n2);
+        hodges_lehmann(x, n1, y, n2, alpha, &shift, &lo, &hi);
+        double mx = median(x, n1);
+        double my = median(y, n2);
+
+        double pct = 100.0 * shift / mx;
+        const char *verdict = "no change";
+        if (n1 < MIN_SAMPLES || n2 < MIN_SAMPLES) {
+            verdict = "too few samples";
+        } else if (p < alpha && pct < -threshold) {
+            verdict = "REGRESSION";
+            regressions++;
+        } else if (p < alpha && pct > threshold) {
+            verdict = "improvement";
+        }
+
+        char ci[32];
+        snprintf(ci, sizeof(ci), "[%+.1f%%, %+.1f%%]", 100.0 * lo / mx, 100.0 * hi / mx);
+        printf("%-24s %12llu %4zu %4zu %12.2f %12.2f %+7.1f%% %19s %9.2g  %s\n",
+               g->group, (unsigned long long)g->size, n1, n2,
+               mx / 1e6, my / 1e6, pct, ci, p, verdict);
+    }
+
+    printf("\n%d regression(s) at alpha %.3g, threshold %.1f%%, %.0f%% confidence intervals\n",
+           regressions, alpha, threshold, 100 * (1 - alpha));
+
+    free(x);
+    free(y);
+    result_set_free(&base);
+    result_set_free(&cand);
+    return regressions ? 1 : 0;
+}
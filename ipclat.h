@@ -0,0 +1,104 @@
+//
+// ipclat.h
+//
+// For questions/support: norman.mcentire@gmail.com
+//
+// Per-message latency distributions.
+//
+// Latencies are taken on CLOCK_MONOTONIC, which is shared by every process
+// on the machine, so a sender can stamp a message and the receiver can
+// subtract.  In open-loop runs the stamp is the time the message was
+// *scheduled* to be sent, not when it actually was: if the sender falls
+// behind, the delay it could not avoid is charged to the messages that
+// queued up behind the stall (coordinated-omission correction).
+//
+#ifndef IPCLAT_H
+#define IPCLAT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ipcresult.h"
+
+static inline uint64_t lat_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Waits until the absolute CLOCK_MONOTONIC time t: sleeps while far
+// ahead, then spins, since a sleep alone overshoots by tens of microseconds
+static inline void lat_wait_until(uint64_t t) {
+    uint64_t now = lat_now_ns();
+    if (now + 100000 < t) {
+        uint64_t wake = t - 50000;
+        struct timespec ts = { (time_t)(wake / 1000000000ull), (long)(wake % 1000000000ull) };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+    while (lat_now_ns() < t) {
+    }
+}
+
+// Parses a list of steps for a sweep: "1000,5000,20000", or "A:B" for
+// A, 2A, 4A, ... up to B.  Returns the number of steps, -1 if invalid.
+static inline int lat_parse_steps(const char *arg, double *steps, int max) {
+    int n = 0;
+    const char *p = arg;
+    while (*p) {
+        char *end;
+        double a = strtod(p, &end), b;
+        if (end == p || a <= 0) return -1;
+        b = a;
+        if (*end == ':') {
+            p = end + 1;
+            b = strtod(p, &end);
+            if (end == p || b < a) return -1;
+        }
+        for (double v = a; v <= b * 1.000001 && n < max; v *= 2) steps[n++] = v;
+        if (*end == ',') end++;
+        else if (*end) return -1;
+        p = end;
+    }
+    return n;
+}
+
+static inline int lat_cmp(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of sorted v
+static inline double lat_percentile(const double *v, size_t n, double p) {
+    size_t rank = (size_t)(p / 100.0 * n + 0.999999);
+    if (rank < 1) rank = 1;
+    if (rank > n) rank = n;
+    return v[rank - 1];
+}
+
+// Sorts v (seconds) and fills in the distribution; rate is left as is
+static inline void lat_summarize(double *v, size_t n, ipc_latency_t *out) {
+    out->count = n;
+    if (n == 0) {
+        out->p50 = out->p90 = out->p99 = out->p999 = out->max = 0;
+        return;
+    }
+    qsort(v, n, sizeof(double), lat_cmp);
+    out->p50 = lat_percentile(v, n, 50);
+    out->p90 = lat_percentile(v, n, 90);
+    out->p99 = lat_percentile(v, n, 99);
+    out->p999 = lat_percentile(v, n, 99.9);
+    out->max = v[n - 1];
+}
+
+static inline void lat_print_header(const char *prefix, const char *first) {
+    printf("%s%12s %12s %10s %10s %10s %10s %10s\n", prefix, first, "Achieved/s",
+           "p50 us", "p90 us", "p99 us", "p99.9 us", "max us");
+}
+
+static inline void lat_print(const char *prefix, double first, double achieved, const ipc_latency_t *l) {
+    printf("%s%12.0f %12.1f %10.2f %10.2f %10.2f %10.2f %10.2f\n", prefix, first, achieved,
+           l->p50 * 1e6, l->p90 * 1e6, l->p99 * 1e6, l->p999 * 1e6, l->max * 1e6);
+}
+
+#endif // IPCLAT_H
@@ -0,0 +1,300 @@
+//
+// ipcload.c
+//
+// For questions/support: norman.mcentire@gmail.com
+//
+// To build: gcc -Wall -O2 ipcload.c -o ipcload -lpthread
+//
+// Background contention for measuring IPC under noisy neighbours.  Runs
+// until SIGINT/SIGTERM (or --duration seconds) with:
+//
+//   --cpu N   threads spinning on integer arithmetic
+//   --mem N   threads copying between two buffers far larger than the LLC
+//             (memory-bandwidth hogs)
+//   --llc N   threads sweeping a buffer of 2x the LLC line by line, so the
+//             measured processes keep losing their cache lines
+//
+// Threads are pinned round-robin to --cpus LIST, or with --siblings-of LIST
+// to the SMT siblings of those CPUs (the measured CPUs themselves are
+// excluded).  ipcsuite.sh --load runs each size idle and under this load
+// and reports the difference.
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/time.h>
+#include "ipcstream.h"
+
+#define MAX_THREADS 256
+#define LINE 64
+
+enum { LOAD_CPU = 0, LOAD_MEM, LOAD_LLC };
+
+static const char *load_names[] = { "cpu", "mem", "llc" };
+
+typedef struct {
+    pthread_t tid;
+    int kind;
+    int cpu;           // -1 when not pinned
+    size_t bytes;      // Buffer size for mem/llc threads
+    uint64_t work;     // Iterations (cpu) or bytes touched (mem, llc)
+} load_thread_t;
+
+volatile int stop = 0;
+
+void *cpu_spin(void *arg) {
+    load_thread_t *t = arg;
+    volatile uint64_t x = 1;
+    while (!stop) {
+        for (int i = 0; i < 1000000; i++) x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        t->work += 1000000;
+    }
+    return NULL;
+}
+
+void *mem_hog(void *arg) {
+    load_thread_t *t = arg;
+    size_t half = t->bytes / 2;
+    uint8_t *buf = malloc(t->bytes);
+    if (!buf) {
+        perror("malloc");
+        return NULL;
+    }
+    memset(buf, 1, t->bytes);
+    while (!stop) {
+        memcpy(buf + half, buf, half);
+        t->work += 2 * half;  // Read and written
+        memcpy(buf, buf + half, half);
+        t->work += 2 * half;
+    }
+    free(buf);
+    return NULL;
+}
+
+void *llc_thrash(void *arg) {
+    load_thread_t *t = arg;
+    volatile uint8_t *buf = malloc(t->bytes);
+    if (!buf) {
+        perror("malloc");
+        return NULL;
+    }
+    memset((void *)buf, 0, t->bytes);
+
+    // Stride by a prime number of lines so the hardware prefetcher cannot
+    // follow and every access is a fresh (dirty) line
+    size_t lines = t->bytes / LINE, step = 4099, i = 0;
+    while (!stop) {
+        for (size_t n = 0; n < lines; n++) {
+            buf[i * LINE]++;
+            i += step;
+            if (i >= lines) i -= lines;
+        }
+        t->work += lines * LINE;
+    }
+    free((void *)buf);
+    return NULL;
+}
+
+// Parses "0-3,8" into cpus[]; returns the count or -1
+int parse_cpu_list(const char *list, int *cpus, int max) {
+    int n = 0;
+    const char *p = list;
+    while (*p) {
+        char *end;
+        long a = strtol(p, &end, 10), b;
+        if (end == p || a < 0) return -1;
+        b = a;
+        if (*end == '-') {
+            p = end + 1;
+            b = strtol(p, &end, 10);
+            if (end == p || b < a) return -1;
+        }
+        for (long c = a; c <= b && n < max; c++) cpus[n++] = (int)c;
+        if (*end == ',') end++;
+        else if (*end) return -1;
+        p = end;
+    }
+    return n;
+}
+
+// SMT siblings of each listed CPU, without the listed CPUs themselves
+int sibling_cpus(const char *list, int *cpus, int max) {
+    int measured[CPU_SETSIZE];
+    int nm = parse_cpu_list(list, measured, CPU_SETSIZE);
+    if (nm < 0) return -1;
+
+    int n = 0;
+    for (int i = 0; i < nm; i++) {
+        char path[128], line[256];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/thread_siblings_list", measured[i]);
+        FILE *fp = fopen(path, "r");
+        if (!fp) continue;
+        if (fgets(line, sizeof(line), fp)) {
+            line[strcspn(line, "\n")] = '\0';
+            int sib[CPU_SETSIZE];
+            int ns = parse_cpu_list(line, sib, CPU_SETSIZE);
+            for (int k = 0; k < ns && n < max; k++) {
+                int skip = 0;
+                for (int j = 0; j < nm; j++) skip |= sib[k] == measured[j];
+                for (int j = 0; j < n; j++) skip |= sib[k] == cpus[j];
+                if (!skip) cpus[n++] = sib[k];
+            }
+        }
+        fclose(fp);
+    }
+    return n;
+}
+
+int main(int argc, char *argv[]) {
+    int counts[3] = { 0, 0, 0 };
+    uint64_t mem_size = 0;   // Per mem thread; default 4x the LLC, 64 MB to 1 GB
+    const char *cpu_list = NULL;
+    const char *siblings_of = NULL;
+    int duration = 0;
+
+    static struct option long_options[] = {
+        {"cpu", required_argument, 0, 'c'},
+        {"mem", required_argument, 0, 'm'},
+        {"llc", required_argument, 0, 'l'},
+        {"mem-size", required_argument, 0, 'M'},
+        {"cpus", required_argument, 0, 'p'},
+        {"siblings-of", required_argument, 0, 'S'},
+        {"duration", required_argument, 0, 'd'},
+        {0, 0, 0, 0}
+    };
+
+    while (1) {
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "c:m:l:M:p:S:d:", long_options, &option_index);
+        if (c == -1) break;
+
+        switch (c) {
+            case 'c':
+                counts[LOAD_CPU] = atoi(optarg);
+                break;
+            case 'm':
+                counts[LOAD_MEM] = atoi(optarg);
+                break;
+            case 'l':
+                counts[LOAD_LLC] = atoi(optarg);
+                break;
+            case 'M':
+                if (parse_size(optarg, &mem_size) < 0 || mem_size < 2 * LINE) {
+                    fprintf(stderr, "Invalid mem size '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'p':
+                cpu_list = optarg;
+                break;
+            case 'S':
+                siblings_of = optarg;
+                break;
+            case 'd':
+                duration = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [--cpu N] [--mem N] [--llc N] [--mem-size BYTES] [--cpus LIST | --siblings-of LIST] [--duration SECONDS]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    int total = counts[LOAD_CPU] + counts[LOAD_MEM] + counts[LOAD_LLC];
+    if (total <= 0 || total > MAX_THREADS || counts[0] < 0 || counts[1] < 0 || counts[2] < 0) {
+        fprintf(stderr, "Specify between 1 and %d threads with --cpu, --mem and --llc.\n", MAX_THREADS);
+        return EXIT_FAILURE;
+    }
+
+    int cpus[CPU_SETSIZE];
+    int ncpus = 0;
+    if (cpu_list) ncpus = parse_cpu_list(cpu_list, cpus, CPU_SETSIZE);
+    else if (siblings_of) ncpus = sibling_cpus(siblings_of, cpus, CPU_SETSIZE);
+    if (ncpus < 0) {
+        fprintf(stderr, "Invalid CPU list '%s'.\n", cpu_list ? cpu_list : siblings_of);
+        return EXIT_FAILURE;
+    }
+    if (siblings_of && ncpus == 0) {
+        fprintf(stderr, "No SMT siblings of CPUs %s; running unpinned.\n", siblings_of);
+    }
+
+    size_t llc = llc_size();
+    if (!mem_size) {
+        mem_size = 4 * (uint64_t)llc;
+        if (mem_size < (64 << 20)) mem_size = 64 << 20;
+        if (mem_size > (1 << 30)) mem_size = 1 << 30;
+    }
+
+    // Blocked before the threads start so they inherit the mask and only
+    // the main thread's sigwait() sees the stop signals
+    sigset_t stop_set;
+    sigemptyset(&stop_set);
+    sigaddset(&stop_set, SIGINT);
+    sigaddset(&stop_set, SIGTERM);
+    sigaddset(&stop_set, SIGALRM);
+    pthread_sigmask(SIG_BLOCK, &stop_set, NULL);
+
+    static load_thread_t threads[MAX_THREADS];
+    void *(*fns[])(void *) = { cpu_spin, mem_hog, llc_thrash };
+    int n = 0;
+    // A failed pthread_create() ends both loops: total counts what to join
+    for (int kind = 0; kind < 3 && !stop; kind++) {
+        for (int i = 0; i < counts[kind]; i++, n++) {
+            load_thread_t *t = &threads[n];
+            t->kind = kind;
+            t->cpu = ncpus ? cpus[n % ncpus] : -1;
+            t->bytes = kind == LOAD_MEM ? mem_size : 2 * llc;
+
+            pthread_attr_t attr;
+            pthread_attr_init(&attr);
+            if (t->cpu >= 0) {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(t->cpu, &set);
+                pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+            }
+            int rc = pthread_create(&t->tid, &attr, fns[kind], t);
+            pthread_attr_destroy(&attr);
+            if (rc != 0) {
+                fprintf(stderr, "pthread_create: %s\n", strerror(rc));
+                stop = 1;
+                total = n;
+                break;
+            }
+        }
+    }
+
+    struct timeval start, end;
+    gettimeofday(&start, NULL);
+    if (duration > 0) alarm(duration);
+    if (!stop) {
+        int sig;
+        sigwait(&stop_set, &sig);
+        stop = 1;
+    }
+
+    for (int i = 0; i < total; i++) pthread_join(threads[i].tid, NULL);
+    gettimeofday(&end, NULL);
+
+    double elapsed = (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+    for (int i = 0; i < total; i++) {
+        load_thread_t *t = &threads[i];
+        char where[16] = "unpinned";
+        if (t->cpu >= 0) snprintf(where, sizeof(where), "cpu %d", t->cpu);
+        if (t->kind == LOAD_CPU) {
+            printf("[Load] %-4s %-9s %.2f M iterations/sec\n", load_names[t->kind], where,
+                   elapsed > 0 ? t->work / elapsed / 1e6 : 0);
+        } else {
+            printf("[Load] %-4s %-9s %.2f MB/sec over %zu bytes\n", load_names[t->kind], where,
+                   elapsed > 0 ? t->work / elapsed / 1e6 : 0, t->bytes);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
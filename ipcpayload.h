@@ -0,0 +1,112 @@
+//
+// ipcpayload.h
+//
+// For questions/support: norman.mcentire@gmail.com
+//
+// Payload contents and placement (--pattern, --align).
+//
+//   seq     the usual 0, 1, 2, ... bytes
+//   random  bytes from a fixed-seed xorshift generator: incompressible, and
+//           the same on every run
+//   zero    all zero.  The sender's buffer is freshly mapped and never
+//           written, so every payload page that does not share the header's
+//           page is the kernel's shared zero page, which some copy paths
+//           short-circuit
+//
+// By default a tool's header struct comes from malloc() and the payload
+// follows it at whatever offset that gives.  --align SRC[,DST] instead
+// places the sender's payload SRC bytes and the receiver's DST bytes past
+// a page boundary (0 is page aligned), with the header right before it.
+//
+#ifndef IPCPAYLOAD_H
+#define IPCPAYLOAD_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+enum { PATTERN_SEQ = 0, PATTERN_RANDOM, PATTERN_ZERO };
+
+static const char *payload_pattern_names[] = { "seq", "random", "zero" };
+
+typedef struct {
+    void *base;     // What to release
+    size_t len;     // Mapped length, 0 when base came from malloc()
+} payload_buf_t;
+
+static inline int payload_pattern_parse(const char *arg) {
+    for (int i = 0; i < 3; i++) {
+        if (strcmp(arg, payload_pattern_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+// "SRC" or "SRC,DST", each less than a page; SRC alone sets both
+static inline int payload_align_parse(const char *arg, long *src, long *dst) {
+    long page = sysconf(_SC_PAGESIZE);
+    char *end;
+    *src = strtol(arg, &end, 10);
+    if (end == arg || *src < 0 || *src >= page) return -1;
+    *dst = *src;
+    if (*end == ',') {
+        const char *p = end + 1;
+        *dst = strtol(p, &end, 10);
+        if (end == p || *dst < 0 || *dst >= page) return -1;
+    }
+    return *end == '\0' ? 0 : -1;
+}
+
+// Room for a hdr-byte header followed by size payload bytes; returns the
+// header.  offset < 0 keeps plain malloc() placement unless untouched is
+// set, which always maps fresh pages (for the zero pattern).
+static inline void *payload_alloc(payload_buf_t *b, size_t hdr, uint64_t size, long offset, int untouched) {
+    if (offset < 0 && !untouched) {
+        b->len = 0;
+        b->base = malloc(hdr + size);
+        return b->base;
+    }
+
+    // One page in front of the payload's page holds the header
+    long page = sysconf(_SC_PAGESIZE);
+    if (offset < 0) offset = 0;
+    b->len = 2 * page + offset + size;
+    b->base = mmap(NULL, b->len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (b->base == MAP_FAILED) {
+        b->base = NULL;
+        return NULL;
+    }
+    return (uint8_t *)b->base + page + offset - hdr;
+}
+
+// The payload's offset from a page boundary as payload_alloc() placed it,
+// for the record; -1 when malloc() chose
+static inline long payload_offset(long offset, int untouched) {
+    if (offset >= 0) return offset;
+    return untouched ? 0 : -1;
+}
+
+static inline void payload_free(payload_buf_t *b) {
+    if (b->len) munmap(b->base, b->len);
+    else free(b->base);
+    b->base = NULL;
+}
+
+// Fills a payload; zero leaves it alone, relying on payload_alloc()
+static inline void payload_fill(uint8_t *p, uint64_t size, int pattern) {
+    if (pattern == PATTERN_SEQ) {
+        for (uint64_t i = 0; i < size; i++) p[i] = (uint8_t)i;
+    } else if (pattern == PATTERN_RANDOM) {
+        uint64_t x = 0x9e3779b97f4a7c15ULL;
+        for (uint64_t i = 0; i < size; i += 8) {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            memcpy(p + i, &x, size - i < 8 ? size - i : 8);
+        }
+    }
+}
+
+#endif // IPCPAYLOAD_H
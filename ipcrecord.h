@@ -0,0 +1,293 @@
+//
+// ipcrecord.h
+//
+// For questions/support: norman.mcentire@gmail.com
+//
+// Structured messages (--codec): a generator of typed records and the
+// codecs that turn them into a payload and back.
+//
+//   raw   each record as one packed struct: fixed offsets, fixed-width
+//         strings, no framing.  The cheapest encoding there is.
+//   tlv   every field as a tag, a type, a 16-bit length and the value;
+//         strings carry only their own length.  The decoder dispatches on
+//         the tag, so fields may come in any order and unknown ones are
+//         skipped, as in any extensible wire format.
+//
+// dbusmemcpy also has --codec dbus, which marshals each record as a D-Bus
+// struct of typed arguments.
+//
+// Records are generated from their index alone, so the receiver checks a
+// decoded batch by generating it again.  Both sides assume the same byte
+// order.
+//
+#ifndef IPCRECORD_H
+#define IPCRECORD_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <inttypes.h>
+#include <string.h>
+
+#define RECORD_SAMPLES 8
+#define RECORD_NAME_MAX 32
+#define RECORD_UNIT_MAX 8
+#define RECORD_FIELDS 14
+
+enum { CODEC_RAW = 0, CODEC_TLV, CODEC_DBUS };
+
+static const char *record_codec_names[] = { "raw", "tlv", "dbus" };
+
+typedef struct {
+    uint64_t id;
+    int64_t timestamp_ns;
+    uint32_t sequence;
+    int32_t offset;
+    uint16_t port;
+    int16_t delta;
+    uint8_t kind;
+    uint8_t flags;
+    uint8_t valid;                  // 0 or 1
+    double value;
+    float ratio;
+    double samples[RECORD_SAMPLES];
+    char name[RECORD_NAME_MAX];     // NUL terminated, 4 to 31 characters
+    char unit[RECORD_UNIT_MAX];
+} ipc_record_t;
+
+// The raw codec's wire layout
+typedef struct __attribute__((packed)) {
+    uint64_t id;
+    int64_t timestamp_ns;
+    uint32_t sequence;
+    int32_t offset;
+    uint16_t port;
+    int16_t delta;
+    uint8_t kind;
+    uint8_t flags;
+    uint8_t valid;
+    double value;
+    float ratio;
+    uint8_t samples[RECORD_SAMPLES * sizeof(double)];
+    char name[RECORD_NAME_MAX];
+    char unit[RECORD_UNIT_MAX];
+} record_raw_t;
+
+enum { TLV_RECORD = 0, TLV_U8, TLV_U16, TLV_U32, TLV_U64, TLV_I16, TLV_I32, TLV_I64,
+       TLV_BOOL, TLV_F32, TLV_F64, TLV_F64_ARRAY, TLV_STRING };
+
+// Tag i + 1 is field i
+static const struct {
+    uint8_t type;
+    uint16_t offset;
+    uint16_t size;      // Capacity for strings
+} record_fields[RECORD_FIELDS] = {
+    { TLV_U64, offsetof(ipc_record_t, id), 8 },
+    { TLV_I64, offsetof(ipc_record_t, timestamp_ns), 8 },
+    { TLV_U32, offsetof(ipc_record_t, sequence), 4 },
+    { TLV_I32, offsetof(ipc_record_t, offset), 4 },
+    { TLV_U16, offsetof(ipc_record_t, port), 2 },
+    { TLV_I16, offsetof(ipc_record_t, delta), 2 },
+    { TLV_U8, offsetof(ipc_record_t, kind), 1 },
+    { TLV_U8, offsetof(ipc_record_t, flags), 1 },
+    { TLV_BOOL, offsetof(ipc_record_t, valid), 1 },
+    { TLV_F64, offsetof(ipc_record_t, value), 8 },
+    { TLV_F32, offsetof(ipc_record_t, ratio), 4 },
+    { TLV_F64_ARRAY, offsetof(ipc_record_t, samples), RECORD_SAMPLES * sizeof(double) },
+    { TLV_STRING, offsetof(ipc_record_t, name), RECORD_NAME_MAX },
+    { TLV_STRING, offsetof(ipc_record_t, unit), RECORD_UNIT_MAX },
+};
+
+#define TLV_HDR 4
+#define RECORD_TLV_MAX (TLV_HDR + RECORD_FIELDS * TLV_HDR + sizeof(record_raw_t))
+
+// "raw", "tlv", and "dbus" where the tool can marshal D-Bus arguments
+static inline int record_codec_parse(const char *arg, int allow_dbus) {
+    for (int i = 0; i < (allow_dbus ? 3 : 2); i++) {
+        if (strcmp(arg, record_codec_names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+// Records that fit raw in size bytes, at least one
+static inline uint64_t record_count(uint64_t size) {
+    uint64_t n = size / sizeof(record_raw_t);
+    return n ? n : 1;
+}
+
+// Encoded bytes for n records, at most; D-Bus structs also fit the TLV bound
+static inline uint64_t record_max_size(int codec, uint64_t n) {
+    return n * (codec == CODEC_RAW ? sizeof(record_raw_t) : RECORD_TLV_MAX);
+}
+
+static inline uint64_t record_next(uint64_t *x) {
+    *x ^= *x << 13;
+    *x ^= *x >> 7;
+    *x ^= *x << 17;
+    return *x;
+}
+
+// Record i; padding is zeroed so decoded records compare with memcmp()
+static inline void record_generate(ipc_record_t *r, uint64_t i) {
+    static const char *units[] = { "ms", "degC", "kPa", "V", "rpm" };
+    uint64_t x = (i + 1) * 0x9e3779b97f4a7c15ULL;
+
+    memset(r, 0, sizeof(*r));
+    r->id = i;
+    r->timestamp_ns = 1700000000000000000LL + (int64_t)i * 1000;
+    r->sequence = (uint32_t)record_next(&x);
+    r->offset = (int32_t)record_next(&x);
+    r->port = (uint16_t)record_next(&x);
+    r->delta = (int16_t)record_next(&x);
+    r->kind = (uint8_t)(i % 7);
+    r->flags = (uint8_t)record_next(&x);
+    r->valid = record_next(&x) & 1;
+    r->value = (int64_t)record_next(&x) / 1e9;
+    r->ratio = (record_next(&x) % 10000) / 10000.0f;
+    for (int k = 0; k < RECORD_SAMPLES; k++) r->samples[k] = (record_next(&x) % 1000000) / 1000.0;
+    int len = 4 + (int)(record_next(&x) % (RECORD_NAME_MAX - 4));
+    for (int k = 0; k < len; k++) r->name[k] = (char)('a' + record_next(&x) % 26);
+    strcpy(r->unit, units[i % 5]);
+}
+
+// Regenerates records 0..n-1 and compares; returns the number that differ
+static inline uint64_t record_check(const ipc_record_t *v, uint64_t n) {
+    uint64_t bad = 0;
+    ipc_record_t r;
+    for (uint64_t i = 0; i < n; i++) {
+        record_generate(&r, i);
+        if (memcmp(&r, &v[i], sizeof(r)) != 0) bad++;
+    }
+    return bad;
+}
+
+static inline uint8_t *record_tlv_put(uint8_t *p, uint8_t tag, uint8_t type, const void *v, uint16_t len) {
+    p[0] = tag;
+    p[1] = type;
+    memcpy(p + 2, &len, 2);
+    memcpy(p + TLV_HDR, v, len);
+    return p + TLV_HDR + len;
+}
+
+// Encodes n records into out (record_max_size() bytes); returns the length
+static inline uint64_t record_encode(int codec, const ipc_record_t *v, uint64_t n, uint8_t *out) {
+    if (codec == CODEC_RAW) {
+        record_raw_t *w = (record_raw_t *)out;
+        for (uint64_t i = 0; i < n; i++, w++) {
+            const ipc_record_t *r = &v[i];
+            w->id = r->id;
+            w->timestamp_ns = r->timestamp_ns;
+            w->sequence = r->sequence;
+            w->offset = r->offset;
+            w->port = r->port;
+            w->delta = r->delta;
+            w->kind = r->kind;
+            w->flags = r->flags;
+            w->valid = r->valid;
+            w->value = r->value;
+            w->ratio = r->ratio;
+            memcpy(w->samples, r->samples, sizeof(w->samples));
+            memcpy(w->name, r->name, RECORD_NAME_MAX);
+            memcpy(w->unit, r->unit, RECORD_UNIT_MAX);
+        }
+        return n * sizeof(record_raw_t);
+    }
+
+    uint8_t *p = out;
+    for (uint64_t i = 0; i < n; i++) {
+        const uint8_t *r = (const uint8_t *)&v[i];
+        uint8_t *rec = p;
+        p += TLV_HDR;
+        for (int f = 0; f < RECORD_FIELDS; f++) {
+            const uint8_t *field = r + record_fields[f].offset;
+            uint16_t len = record_fields[f].size;
+            if (record_fields[f].type == TLV_STRING) len = (uint16_t)strlen((const char *)field);
+            p = record_tlv_put(p, (uint8_t)(f + 1), record_fields[f].type, field, len);
+        }
+        uint16_t body = (uint16_t)(p - rec - TLV_HDR);
+        rec[0] = 0;
+        rec[1] = TLV_RECORD;
+        memcpy(rec + 2, &body, 2);
+    }
+    return p - out;
+}
+
+// Decodes len bytes into at most n records; returns how many, -1 if malformed
+static inline int64_t record_decode(int codec, const uint8_t *in, uint64_t len, ipc_record_t *v, uint64_t n) {
+    if (codec == CODEC_RAW) {
+        if (len % sizeof(record_raw_t) || len / sizeof(record_raw_t) > n) return -1;
+        const record_raw_t *w = (const record_raw_t *)in;
+        uint64_t count = len / sizeof(record_raw_t);
+        for (uint64_t i = 0; i < count; i++, w++) {
+            ipc_record_t *r = &v[i];
+            memset(r, 0, sizeof(*r));
+            r->id = w->id;
+            r->timestamp_ns = w->timestamp_ns;
+            r->sequence = w->sequence;
+            r->offset = w->offset;
+            r->port = w->port;
+            r->delta = w->delta;
+            r->kind = w->kind;
+            r->flags = w->flags;
+            r->valid = w->valid;
+            r->value = w->value;
+            r->ratio = w->ratio;
+            memcpy(r->samples, w->samples, sizeof(w->samples));
+            memcpy(r->name, w->name, RECORD_NAME_MAX);
+            memcpy(r->unit, w->unit, RECORD_UNIT_MAX);
+            r->name[RECORD_NAME_MAX - 1] = '\0';
+            r->unit[RECORD_UNIT_MAX - 1] = '\0';
+        }
+        return (int64_t)count;
+    }
+
+    const uint8_t *p = in, *end = in + len;
+    uint64_t count = 0;
+    while (p < end) {
+        uint16_t body;
+        if (end - p < TLV_HDR || p[1] != TLV_RECORD || count == n) return -1;
+        memcpy(&body, p + 2, 2);
+        p += TLV_HDR;
+        if (end - p < body) return -1;
+
+        const uint8_t *rend = p + body;
+        uint8_t *r = (uint8_t *)&v[count++];
+        memset(r, 0, sizeof(ipc_record_t));
+        while (p < rend) {
+            uint16_t flen;
+            if (rend - p < TLV_HDR) return -1;
+            uint8_t tag = p[0], type = p[1];
+            memcpy(&flen, p + 2, 2);
+            p += TLV_HDR;
+            if (rend - p < flen) return -1;
+
+            if (tag >= 1 && tag <= RECORD_FIELDS) {
+                int f = tag - 1;
+                uint16_t cap = record_fields[f].size;
+                if (type != record_fields[f].type) return -1;
+                if (type == TLV_STRING ? flen >= cap : flen != cap) return -1;
+                memcpy(r + record_fields[f].offset, p, flen);
+            }
+            p += flen;
+        }
+    }
+    return (int64_t)count;
+}
+
+// The codec lines under a tool's transfer report, and how encoding,
+// transfer and decoding split the time from the sender's records to the
+// receiver's
+static inline void record_print(const char *prefix, const char *codec, uint64_t n, uint64_t bytes,
+                                double encode, double transfer, double decode) {
+    double total = encode + transfer + decode;
+    printf("%sCodec:        %s, %" PRIu64 " records of %d fields, %" PRIu64 " bytes (%.1f per record)\n",
+           prefix, codec, n, RECORD_FIELDS, bytes, (double)bytes / n);
+    printf("%sEncode:       %.6f seconds (%.0f records/sec)\n", prefix, encode, encode > 0 ? n / encode : 0);
+    printf("%sDecode:       %.6f seconds (%.0f records/sec)\n", prefix, decode, decode > 0 ? n / decode : 0);
+    if (total > 0) {
+        printf("%sEnd to end:   %.6f seconds: %.1f%% encode, %.1f%% transfer, %.1f%% decode\n", prefix, total,
+               100 * encode / total, 100 * transfer / total, 100 * decode / total);
+    }
+}
+
+#endif // IPCRECORD_H
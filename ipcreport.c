@@ -0,0 +1,499 @@
+//
+// ipcreport.c
+//
+// For questions/support: norman.mcentire@gmail.com
+//
+// To build: gcc -Wall ipcreport.c -o ipcreport -lm
+//
+// Renders result files written by the tools with --format json|csv (as
+// collected by ipcsuite.sh) into a timing report: median throughput and
+// latency tables per transport and size, throughput relative to memcpy,
+// and log-log charts of both.  Runs that differ in --pattern, --align or
+// --codec are separate columns (see result_group_name()).  With --load
+// FILE (results of the same matrix under ipcload contention) it adds the
+// loaded throughput and its change relative to the idle runs.  The
+// Markdown report links the charts as SVG files written next to it; the
+// HTML report embeds them.
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <getopt.h>
+#include "ipcresult.h"
+
+#define MAX_TRANSPORTS 32
+#define MAX_SIZES 64
+
+#define CHART_W 720
+#define CHART_H 440
+#define CHART_L 80    // Plot area margins
+#define CHART_R 170
+#define CHART_T 40
+#define CHART_B 50
+
+enum { METRIC_THROUGHPUT = 0, METRIC_LATENCY };
+
+// What a table cell shows: the median itself, or a ratio against memcpy
+// at the same size, or against the same transport and size when idle
+enum { CELL_VALUE = 0, CELL_VS_MEMCPY, CELL_VS_IDLE };
+
+typedef struct {
+    size_t n;
+    double bps;      // Medians
+    double elapsed;
+} cell_t;
+
+typedef struct {
+    char transports[MAX_TRANSPORTS][128];  // Group names
+    int ntransports;
+    uint64_t sizes[MAX_SIZES];
+    int nsizes;
+    cell_t cells[MAX_TRANSPORTS][MAX_SIZES];
+    size_t nsamples;
+} report_t;
+
+static const char *palette[] = {
+    "#1f77b4", "#ff7f0e", "#2ca02c", "#d62728", "#9467bd",
+    "#8c564b", "#e377c2", "#7f7f7f", "#bcbd22", "#17becf"
+};
+
+int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+double median(double *v, size_t n) {
+    qsort(v, n, sizeof(double), cmp_double);
+    return n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+}
+
+// "4096" -> "4K", "1048576" -> "1M"; other sizes are printed in bytes
+void format_size(uint64_t size, char *buf, size_t len) {
+    const char *units = "KMGT";
+    int u = -1;
+    while (size && size % 1024 == 0 && u < 3) {
+        size /= 1024;
+        u++;
+    }
+    if (u < 0) snprintf(buf, len, "%llu", (unsigned long long)size);
+    else snprintf(buf, len, "%llu%c", (unsigned long long)size, units[u]);
+}
+
+// Latency with a unit that keeps three or four significant digits
+void format_time(double s, char *buf, size_t len) {
+    if (s < 1e-3) snprintf(buf, len, "%.2f us", s * 1e6);
+    else if (s < 1) snprintf(buf, len, "%.2f ms", s * 1e3);
+    else snprintf(buf, len, "%.3f s", s);
+}
+
+int find_transport(report_t *r, const char *transport) {
+    for (int i = 0; i < r->ntransports; i++) {
+        if (strcmp(r->transports[i], transport) == 0) return i;
+    }
+    return -1;
+}
+
+int find_size(report_t *r, uint64_t size) {
+    for (int i = 0; i < r->nsizes; i++) {
+        if (r->sizes[i] == size) return i;
+    }
+    return -1;
+}
+
+int build_report(report_t *r, const result_set_t *set) {
+    memset(r, 0, sizeof(*r));
+    r->nsamples = set->n;
+
+    // Transports in first-seen order (the suite's order), sizes ascending
+    for (size_t i = 0; i < set->n; i++) {
+        if (find_transport(r, set->v[i].group) < 0) {
+            if (r->ntransports == MAX_TRANSPORTS) {
+                fprintf(stderr, "Too many transports (max %d).\n", MAX_TRANSPORTS);
+                return -1;
+            }
+            snprintf(r->transports[r->ntransports++], sizeof(r->transports[0]), "%s", set->v[i].group);
+        }
+        if (find_size(r, set->v[i].size) < 0) {
+            if (r->nsizes == MAX_SIZES) {
+                fprintf(stderr, "Too many sizes (max %d).\n", MAX_SIZES);
+                return -1;
+            }
+            r->sizes[r->nsizes++] = set->v[i].size;
+        }
+    }
+    qsort(r->sizes, r->nsizes, sizeof(uint64_t), cmp_u64);
+
+    double *bps = malloc(set->n * sizeof(double));
+    double *elapsed = malloc(set->n * sizeof(double));
+    if (!bps || !elapsed) {
+        perror("malloc");
+        free(bps);
+        free(elapsed);
+        return -1;
+    }
+
+    for (int t = 0; t < r->ntransports; t++) {
+        for (int z = 0; z < r->nsizes; z++) {
+            size_t n = 0;
+            for (size_t i = 0; i < set->n; i++) {
+                if (set->v[i].size == r->sizes[z] && strcmp(set->v[i].group, r->transports[t]) == 0) {
+                    bps[n] = set->v[i].bps;
+                    elapsed[n] = set->v[i].elapsed;
+                    n++;
+                }
+            }
+            cell_t *c = &r->cells[t][z];
+            c->n = n;
+            if (n) {
+                c->bps = median(bps, n);
+                c->elapsed = median(elapsed, n);
+            }
+        }
+    }
+
+    free(bps);
+    free(elapsed);
+    return 0;
+}
+
+double metric_value(const cell_t *c, int metric) {
+    return metric == METRIC_THROUGHPUT ? c->bps / 1e6 : c->elapsed * 1e6;
+}
+
+// Log-log chart: size on x (powers of two), MB/s or microseconds on y (decades)
+void write_svg(FILE *fp, const report_t *r, int metric) {
+    double ymin = INFINITY, ymax = -INFINITY;
+    for (int t = 0; t < r->ntransports; t++) {
+        for (int z = 0; z < r->nsizes; z++) {
+            const cell_t *c = &r->cells[t][z];
+            double v = metric_value(c, metric);
+            if (!c->n || v <= 0) continue;
+            if (v < ymin) ymin = v;
+            if (v > ymax) ymax = v;
+        }
+    }
+    if (ymin > ymax) ymin = ymax = 1;
+    double y0 = floor(log10(ymin)), y1 = ceil(log10(ymax));
+    if (y1 <= y0) y1 = y0 + 1;
+
+    double x0 = floor(log2((double)r->sizes[0]));
+    double x1 = ceil(log2((double)r->sizes[r->nsizes - 1]));
+    if (x1 <= x0) x1 = x0 + 1;
+
+    double pw = CHART_W - CHART_L - CHART_R, ph = CHART_H - CHART_T - CHART_B;
+    #define PX(lx) (CHART_L + ((lx) - x0) / (x1 - x0) * pw)
+    #define PY(ly) (CHART_T + ph - ((ly) - y0) / (y1 - y0) * ph)
+
+    const char *title = metric == METRIC_THROUGHPUT ? "Throughput (MB/s)" : "Latency (microseconds)";
+    fprintf(fp, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" "
+                "font-family=\"sans-serif\" font-size=\"12\">\n", CHART_W, CHART_H);
+    fprintf(fp, "<rect width=\"100%%\" height=\"100%%\" fill=\"white\"/>\n");
+    fprintf(fp, "<text x=\"%d\" y=\"24\" font-size=\"15\">%s vs. size</text>\n", CHART_L, title);
+
+    // Grid and tick labels
+    int xstep = (int)ceil((x1 - x0) / 12);
+    for (int lx = (int)x0; lx <= (int)x1; lx += xstep) {
+        char label[32];
+        format_size((uint64_t)1 << lx, label, sizeof(label));
+        fprintf(fp, "<line x1=\"%.1f\" y1=\"%d\" x2=\"%.1f\" y2=\"%.1f\" stroke=\"#ddd\"/>\n",
+                PX(lx), CHART_T, PX(lx), CHART_T + ph);
+        fprintf(fp, "<text x=\"%.1f\" y=\"%.1f\" text-anchor=\"middle\">%s</text>\n",
+                PX(lx), CHART_T + ph + 18, label);
+    }
+    for (int ly = (int)y0; ly <= (int)y1; ly++) {
+        fprintf(fp, "<line x1=\"%d\" y1=\"%.1f\" x2=\"%.1f\" y2=\"%.1f\" stroke=\"#ddd\"/>\n",
+                CHART_L, PY(ly), CHART_L + pw, PY(ly));
+        fprintf(fp, "<text x=\"%d\" y=\"%.1f\" text-anchor=\"end\">%g</text>\n",
+                CHART_L - 6, PY(ly) + 4, pow(10, ly));
+    }
+    fprintf(fp, "<rect x=\"%d\" y=\"%d\" width=\"%.0f\" height=\"%.0f\" fill=\"none\" stroke=\"#333\"/>\n",
+            CHART_L, CHART_T, pw, ph);
+    fprintf(fp, "<text x=\"%.1f\" y=\"%d\" text-anchor=\"middle\">Size (bytes)</text>\n",
+            CHART_L + pw / 2, CHART_H - 10);
+
+    // One series per transport, plus its legend entry
+    for (int t = 0; t < r->ntransports; t++) {
+        const char *color = palette[t % (sizeof(palette) / sizeof(palette[0]))];
+        fprintf(fp, "<polyline fill=\"none\" stroke=\"%s\" stroke-width=\"2\" points=\"", color);
+        for (int z = 0; z < r->nsizes; z++) {
+            const cell_t *c = &r->cells[t][z];
+            double v = metric_value(c, metric);
+            if (!c->n || v <= 0) continue;
+            fprintf(fp, "%.1f,%.1f ", PX(log2((double)r->sizes[z])), PY(log10(v)));
+        }
+        fprintf(fp, "\"/>\n");
+        for (int z = 0; z < r->nsizes; z++) {
+            const cell_t *c = &r->cells[t][z];
+            double v = metric_value(c, metric);
+            if (!c->n || v <= 0) continue;
+            fprintf(fp, "<circle cx=\"%.1f\" cy=\"%.1f\" r=\"3\" fill=\"%s\"/>\n",
+                    PX(log2((double)r->sizes[z])), PY(log10(v)), color);
+        }
+
+        double ly = CHART_T + 10 + t * 18;
+        fprintf(fp, "<line x1=\"%.1f\" y1=\"%.1f\" x2=\"%.1f\" y2=\"%.1f\" stroke=\"%s\" stroke-width=\"2\"/>\n",
+                CHART_L + pw + 15, ly, CHART_L + pw + 35, ly, color);
+        fprintf(fp, "<text x=\"%.1f\" y=\"%.1f\">%s</text>\n", CHART_L + pw + 40, ly + 4, r->transports[t]);
+    }
+    fprintf(fp, "</svg>\n");
+
+    #undef PX
+    #undef PY
+}
+
+// One table row per size, one column per transport.  Markdown and HTML
+// share the layout; only the cell delimiters differ.
+void write_table(FILE *fp, const report_t *r, int metric, int mode, const report_t *idle, int html) {
+    int base = find_transport((report_t *)r, "memcpy");
+
+    if (html) fprintf(fp, "<table>\n<tr><th>Size</th>");
+    else fprintf(fp, "| Size |");
+    for (int t = 0; t < r->ntransports; t++) {
+        if (html) fprintf(fp, "<th>%s</th>", r->transports[t]);
+        else fprintf(fp, " %s |", r->transports[t]);
+    }
+    if (html) fprintf(fp, "</tr>\n");
+    else {
+        fprintf(fp, "\n|---:|");
+        for (int t = 0; t < r->ntransports; t++) fprintf(fp, "---:|");
+        fprintf(fp, "\n");
+    }
+
+    for (int z = 0; z < r->nsizes; z++) {
+        char label[32];
+        format_size(r->sizes[z], label, sizeof(label));
+        if (html) fprintf(fp, "<tr><td>%s</td>", label);
+        else fprintf(fp, "| %s |", label);
+
+        for (int t = 0; t < r->ntransports; t++) {
+            const cell_t *c = &r->cells[t][z];
+            char cell[64] = "-";
+            if (c->n && mode == CELL_VS_MEMCPY) {
+                const cell_t *b = &r->cells[base][z];
+                if (b->n && b->bps > 0) snprintf(cell, sizeof(cell), "%.1f%%", 100.0 * c->bps / b->bps);
+            } else if (c->n && mode == CELL_VS_IDLE) {
+                int it = find_transport((report_t *)idle, r->transports[t]);
+                int iz = find_size((report_t *)idle, r->sizes[z]);
+                const cell_t *b = it >= 0 && iz >= 0 ? &idle->cells[it][iz] : NULL;
+                if (b && b->n && b->bps > 0) snprintf(cell, sizeof(cell), "%+.1f%%", 100.0 * (c->bps / b->bps - 1));
+            } else if (c->n && metric == METRIC_THROUGHPUT) {
+                snprintf(cell, sizeof(cell), "%.2f", c->bps / 1e6);
+            } else if (c->n) {
+                format_time(c->elapsed, cell, sizeof(cell));
+            }
+            if (html) fprintf(fp, "<td>%s</td>", cell);
+            else fprintf(fp, " %s |", cell);
+        }
+        fprintf(fp, html ? "</tr>\n" : "\n");
+    }
+    if (html) fprintf(fp, "</table>\n");
+}
+
+// Copies the suite's environment file into the report as a preformatted block
+void write_env(FILE *fp, const char *env, int html) {
+    if (!env) return;
+    FILE *in = fopen(env, "r");
+    if (!in) {
+        perror(env);
+        return;
+    }
+    char line[1024];
+    fprintf(fp, html ? "<h2>Environment</h2>\n<pre>\n" : "## Environment\n\n```\n");
+    while (fgets(line, sizeof(line), in)) {
+        if (!html) {
+            fputs(line, fp);
+            continue;
+        }
+        for (char *p = line; *p; p++) {
+            if (*p == '<') fputs("&lt;", fp);
+            else if (*p == '>') fputs("&gt;", fp);
+            else if (*p == '&') fputs("&amp;", fp);
+            else fputc(*p, fp);
+        }
+    }
+    fprintf(fp, html ? "</pre>\n" : "```\n\n");
+    fclose(in);
+}
+
+// FILE.md -> FILE-throughput.svg, FILE-latency.svg
+void chart_path(const char *report, const char *suffix, char *buf, size_t len) {
+    const char *dot = strrchr(report, '.');
+    const char *slash = strrchr(report, '/');
+    int stem = (dot && (!slash || dot > slash)) ? (int)(dot - report) : (int)strlen(report);
+    snprintf(buf, len, "%.*s-%s.svg", stem, report, suffix);
+}
+
+int write_svg_file(const char *path, const report_t *r, int metric) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+    write_svg(fp, r, metric);
+    fclose(fp);
+    return 0;
+}
+
+int write_markdown(const char *path, const report_t *r, const report_t *load, const char *title,
+                   const char *env) {
+    char tput[1024], lat[1024];
+    chart_path(path, "throughput", tput, sizeof(tput));
+    chart_path(path, "latency", lat, sizeof(lat));
+    if (write_svg_file(tput, r, METRIC_THROUGHPUT) < 0 || write_svg_file(lat, r, METRIC_LATENCY) < 0) {
+        return -1;
+    }
+
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+
+    // The charts sit next to the report, so link them by file name
+    const char *tname = strrchr(tput, '/') ? strrchr(tput, '/') + 1 : tput;
+    const char *lname = strrchr(lat, '/') ? strrchr(lat, '/') + 1 : lat;
+
+    fprintf(fp, "# %s\n\n", title);
+    fprintf(fp, "%zu samples, %d transports, %d sizes. Cells are medians over the repetitions.\n\n",
+            r->nsamples, r->ntransports, r->nsizes);
+    write_env(fp, env, 0);
+    fprintf(fp, "## Throughput (MB/s)\n\n");
+    write_table(fp, r, METRIC_THROUGHPUT, CELL_VALUE, NULL, 0);
+    fprintf(fp, "\n![Throughput](%s)\n\n", tname);
+    fprintf(fp, "## Latency\n\n");
+    write_table(fp, r, METRIC_LATENCY, CELL_VALUE, NULL, 0);
+    fprintf(fp, "\n![Latency](%s)\n\n", lname);
+    if (find_transport((report_t *)r, "memcpy") >= 0) {
+        fprintf(fp, "## Throughput relative to memcpy\n\n");
+        write_table(fp, r, METRIC_THROUGHPUT, CELL_VS_MEMCPY, NULL, 0);
+    }
+    if (load) {
+        fprintf(fp, "\n## Throughput under load (MB/s)\n\n");
+        write_table(fp, load, METRIC_THROUGHPUT, CELL_VALUE, NULL, 0);
+        fprintf(fp, "\n## Change under load relative to idle\n\n");
+        write_table(fp, load, METRIC_THROUGHPUT, CELL_VS_IDLE, r, 0);
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+int write_html(const char *path, const report_t *r, const report_t *load, const char *title,
+               const char *env) {
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+
+    fprintf(fp, "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n<title>%s</title>\n", title);
+    fprintf(fp, "<style>\nbody { font-family: sans-serif; margin: 2em; }\n"
+                "table { border-collapse: collapse; margin-bottom: 1em; }\n"
+                "th, td { border: 1px solid #ccc; padding: 4px 8px; text-align: right; }\n"
+                "</style>\n</head>\n<body>\n");
+    fprintf(fp, "<h1>%s</h1>\n", title);
+    fprintf(fp, "<p>%zu samples, %d transports, %d sizes. Cells are medians over the repetitions.</p>\n",
+            r->nsamples, r->ntransports, r->nsizes);
+    write_env(fp, env, 1);
+    fprintf(fp, "<h2>Throughput (MB/s)</h2>\n");
+    write_table(fp, r, METRIC_THROUGHPUT, CELL_VALUE, NULL, 1);
+    write_svg(fp, r, METRIC_THROUGHPUT);
+    fprintf(fp, "<h2>Latency</h2>\n");
+    write_table(fp, r, METRIC_LATENCY, CELL_VALUE, NULL, 1);
+    write_svg(fp, r, METRIC_LATENCY);
+    if (find_transport((report_t *)r, "memcpy") >= 0) {
+        fprintf(fp, "<h2>Throughput relative to memcpy</h2>\n");
+        write_table(fp, r, METRIC_THROUGHPUT, CELL_VS_MEMCPY, NULL, 1);
+    }
+    if (load) {
+        fprintf(fp, "<h2>Throughput under load (MB/s)</h2>\n");
+        write_table(fp, load, METRIC_THROUGHPUT, CELL_VALUE, NULL, 1);
+        fprintf(fp, "<h2>Change under load relative to idle</h2>\n");
+        write_table(fp, load, METRIC_THROUGHPUT, CELL_VS_IDLE, r, 1);
+    }
+    fprintf(fp, "</body>\n</html>\n");
+
+    fclose(fp);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    const char *title = "IPC Timings";
+    const char *env = NULL;
+    const char *markdown = NULL;
+    const char *html = NULL;
+    const char *load_path = NULL;
+
+    static struct option long_options[] = {
+        {"title", required_argument, 0, 't'},
+        {"env", required_argument, 0, 'e'},
+        {"markdown", required_argument, 0, 'm'},
+        {"html", required_argument, 0, 'H'},
+        {"load", required_argument, 0, 'l'},
+        {0, 0, 0, 0}
+    };
+
+    while (1) {
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "t:e:m:H:l:", long_options, &option_index);
+        if (c == -1) break;
+
+        switch (c) {
+            case 't':
+                title = optarg;
+                break;
+            case 'e':
+                env = optarg;
+                break;
+            case 'm':
+                markdown = optarg;
+                break;
+            case 'H':
+                html = optarg;
+                break;
+            case 'l':
+                load_path = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [--title TEXT] [--env FILE] [--markdown FILE] [--html FILE] [--load FILE] RESULTS...\n", argv[0]);
+                return 2;
+        }
+    }
+
+    if (optind == argc || (!markdown && !html)) {
+        fprintf(stderr, "Usage: %s [--title TEXT] [--env FILE] [--markdown FILE] [--html FILE] [--load FILE] RESULTS...\n", argv[0]);
+        return 2;
+    }
+
+    result_set_t set = { 0 };
+    for (int i = optind; i < argc; i++) {
+        if (result_load(argv[i], &set) < 0) return 2;
+    }
+    if (set.n == 0) {
+        fprintf(stderr, "No result records found.\n");
+        return 2;
+    }
+
+    static report_t report, load_report;
+    if (build_report(&report, &set) < 0) return 2;
+    result_set_free(&set);
+
+    report_t *load = NULL;
+    if (load_path) {
+        if (result_load(load_path, &set) < 0 || build_report(&load_report, &set) < 0) return 2;
+        result_set_free(&set);
+        if (load_report.nsamples) load = &load_report;
+    }
+
+    if (markdown && write_markdown(markdown, &report, load, title, env) < 0) return 2;
+    if (html && write_html(html, &report, load, title, env) < 0) return 2;
+    return 0;
+}
@@ -0,0 +1,457 @@
+//
+// ipcresult.h
+//
+// For questions/support: norman.mcentire@gmail.com
+//
+// Machine-readable results for every tool (--format json|csv).
+//
+// Each run emits one sample record: the measurement plus host metadata
+// (kernel, CPU model, frequency governor and the CPU affinity of the
+// measuring process).  Multi-message runs add the offered rate and latency
+// percentiles; the CSV columns are always present and left empty otherwise.
+// When IPC_PEAK_BPS is set in the environment (the peak copy bandwidth
+// measured by streambw, in bytes copied per second), throughput is also
+// reported as a percentage of it.  Tools with --pattern/--align (see
+// ipcpayload.h) add the pattern and payload offsets, and those with
+// --codec (see ipcrecord.h) the codec, record count and the encode and
+// decode times, which elapsed_s leaves out.  JSON output is one object
+// per line; CSV output writes a header first when the file is new or
+// empty.  With --output FILE records are appended, so repeated runs
+// accumulate into one file that ipccompare and ipcreport can read back
+// with result_load().  Without --output the records go to stdout and the
+// text report moves to stderr (see result_redirect_text()), so stdout
+// parses as-is.
+//
+// Needs _GNU_SOURCE (for sched_getaffinity) defined before any include.
+//
+#ifndef IPCRESULT_H
+#define IPCRESULT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <inttypes.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/utsname.h>
+
+enum { RESULT_TEXT = 0, RESULT_JSON, RESULT_CSV };
+
+// Per-message latency distribution, for runs that send many messages
+typedef struct {
+    double rate;            // Offered messages/sec, 0 if not rate-controlled
+    uint64_t count;         // Messages measured
+    double p50, p90, p99, p999, max;  // Seconds
+} ipc_latency_t;
+
+// Payload contents and placement, for tools that can vary them
+typedef struct {
+    const char *pattern;    // "seq", "random", "zero"
+    long src_offset;        // Payload offset from a page boundary, -1 if not placed
+    long dst_offset;
+} ipc_payload_t;
+
+// Structured-message codec, for runs with --codec
+typedef struct {
+    const char *codec;      // "raw", "tlv", "dbus"
+    uint64_t records;
+    double encode, decode;  // Seconds, each outside elapsed
+} ipc_codec_t;
+
+typedef struct {
+    const char *transport;  // e.g. "tcp", "dbus-direct"
+    uint64_t size;          // Payload bytes
+    double elapsed;         // Seconds
+    int verified;           // -1 not checked, 0 mismatch, 1 ok
+    const ipc_latency_t *latency;  // NULL for single transfers
+    const ipc_payload_t *payload;  // NULL if the tool does not vary it
+    const ipc_codec_t *codec;      // NULL for opaque payloads
+} ipc_result_t;
+
+static inline int result_format_parse(const char *arg) {
+    if (strcmp(arg, "text") == 0) return RESULT_TEXT;
+    if (strcmp(arg, "json") == 0) return RESULT_JSON;
+    if (strcmp(arg, "csv") == 0) return RESULT_CSV;
+    return -1;
+}
+
+// Peak copy bandwidth from IPC_PEAK_BPS, or 0 when it is not set
+static inline double result_peak_bps(void) {
+    const char *v = getenv("IPC_PEAK_BPS");
+    double peak = v ? strtod(v, NULL) : 0;
+    return peak > 0 ? peak : 0;
+}
+
+// "Of peak:" line under a tool's throughput, when the peak is known
+static inline void result_print_peak(const char *prefix, double bps) {
+    double peak = result_peak_bps();
+    if (peak > 0) {
+        printf("%sOf peak:      %.1f%% of %.2f MB/sec copy bandwidth\n", prefix, 100 * bps / peak, peak / 1e6);
+    }
+}
+
+// Reads the first line of a small file, without the newline
+static inline void result_read_line(const char *path, char *buf, size_t len) {
+    snprintf(buf, len, "unknown");
+    FILE *fp = fopen(path, "r");
+    if (!fp) return;
+    if (fgets(buf, (int)len, fp)) buf[strcspn(buf, "\n")] = '\0';
+    fclose(fp);
+}
+
+static inline void result_cpu_model(char *buf, size_t len) {
+    char line[256];
+    snprintf(buf, len, "unknown");
+    FILE *fp = fopen("/proc/cpuinfo", "r");
+    if (!fp) return;
+    while (fgets(line, sizeof(line), fp)) {
+        // "model name" on x86, "Processor" on older ARM kernels
+        if (strncmp(line, "model name", 10) == 0 || strncmp(line, "Processor", 9) == 0) {
+            char *v = strchr(line, ':');
+            if (v) {
+                v += strspn(v + 1, " \t") + 1;
+                v[strcspn(v, "\n")] = '\0';
+                snprintf(buf, len, "%s", v);
+            }
+            break;
+        }
+    }
+    fclose(fp);
+}
+
+// CPU list of the calling process in compact form, e.g. "0-3,8"
+static inline void result_affinity(char *buf, size_t len) {
+    cpu_set_t set;
+    size_t used = 0;
+    buf[0] = '\0';
+    if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+        snprintf(buf, len, "unknown");
+        return;
+    }
+    for (int cpu = 0; cpu < CPU_SETSIZE && used < len; cpu++) {
+        if (!CPU_ISSET(cpu, &set)) continue;
+        int last = cpu;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, &set)) last++;
+        if (last == cpu) {
+            used += snprintf(buf + used, len - used, "%s%d", used ? "," : "", cpu);
+        } else {
+            used += snprintf(buf + used, len - used, "%s%d-%d", used ? "," : "", cpu, last);
+        }
+        cpu = last;
+    }
+}
+
+// Strings are written quoted in both formats; escape what would break them
+static inline void result_put_string(FILE *fp, int format, const char *s) {
+    fputc('"', fp);
+    for (; *s; s++) {
+        if (*s == '"') fputs(format == RESULT_JSON ? "\\\"" : "\"\"", fp);
+        else if (*s == '\\' && format == RESULT_JSON) fputs("\\\\", fp);
+        else fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+// Where records written to stdout go once result_redirect_text() has run
+static FILE *result_stdout;
+
+// Call after option parsing (and before any fork): with a machine format
+// and no --output file, keep the original stdout for records only and
+// point fd 1 at stderr, so every printf of the text report lands there
+static inline void result_redirect_text(int format, const char *path) {
+    if (format == RESULT_TEXT || path || result_stdout) return;
+    fflush(stdout);
+    int fd = dup(STDOUT_FILENO);
+    if (fd < 0) return;
+    result_stdout = fdopen(fd, "w");
+    if (!result_stdout) {
+        close(fd);
+        return;
+    }
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+}
+
+static inline int result_emit(int format, const char *path, const ipc_result_t *r) {
+    if (format == RESULT_TEXT) return 0;
+
+    FILE *out = result_stdout ? result_stdout : stdout;
+    FILE *fp = out;
+    if (path) {
+        fp = fopen(path, "a");
+        if (!fp) {
+            perror(path);
+            return -1;
+        }
+    }
+
+    struct utsname uts;
+    char kernel[256], cpu[128], governor[64], affinity[256], stamp[32];
+    uname(&uts);
+    snprintf(kernel, sizeof(kernel), "%s %s", uts.sysname, uts.release);
+    result_cpu_model(cpu, sizeof(cpu));
+    result_read_line("/sys/devices/system/cpu/cpu0/cpufreq/scaling_governor", governor, sizeof(governor));
+    result_affinity(affinity, sizeof(affinity));
+
+    time_t now = time(NULL);
+    strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    double bps = r->elapsed > 0 ? r->size / r->elapsed : 0;
+    double peak = result_peak_bps();
+    const char *verified = r->verified < 0 ? "unchecked" : (r->verified ? "ok" : "failed");
+
+    const char *keys[] = { "timestamp", "host", "kernel", "cpu_model", "governor", "affinity",
+                           "transport", "verified" };
+    const char *vals[] = { stamp, uts.nodename, kernel, cpu, governor, affinity,
+                           r->transport, verified };
+    size_t nstr = sizeof(keys) / sizeof(keys[0]);
+
+    if (format == RESULT_CSV) {
+        // Once per process on stdout, once per file otherwise
+        static int stdout_header;
+        if (fp != out) fseek(fp, 0, SEEK_END);
+        if ((fp == out && !stdout_header++) || (fp != out && ftell(fp) == 0)) {
+            for (size_t i = 0; i < nstr; i++) fprintf(fp, "%s,", keys[i]);
+            // New columns go at the end, so files written by older
+            // versions keep lining up with their header
+            fprintf(fp, "size,elapsed_s,bytes_per_sec,mb_per_sec,"
+                        "offered_rate,messages,p50_us,p90_us,p99_us,p999_us,max_us,"
+                        "pattern,src_offset,dst_offset,codec,records,encode_s,decode_s,pct_of_peak\n");
+        }
+        for (size_t i = 0; i < nstr; i++) {
+            result_put_string(fp, format, vals[i]);
+            fputc(',', fp);
+        }
+        fprintf(fp, "%" PRIu64 ",%.9f,%.2f,%.2f,", r->size, r->elapsed, bps, bps / 1e6);
+        const ipc_latency_t *l = r->latency;
+        if (l) {
+            fprintf(fp, "%.1f,%" PRIu64 ",%.3f,%.3f,%.3f,%.3f,%.3f,", l->rate, l->count,
+                    l->p50 * 1e6, l->p90 * 1e6, l->p99 * 1e6, l->p999 * 1e6, l->max * 1e6);
+        } else {
+            fprintf(fp, ",,,,,,,");
+        }
+        const ipc_payload_t *pl = r->payload;
+        if (pl) {
+            fprintf(fp, "%s,", pl->pattern);
+            if (pl->src_offset >= 0) fprintf(fp, "%ld", pl->src_offset);
+            fputc(',', fp);
+            if (pl->dst_offset >= 0) fprintf(fp, "%ld", pl->dst_offset);
+        } else {
+            fputc(',', fp);
+            fputc(',', fp);
+        }
+        const ipc_codec_t *cd = r->codec;
+        if (cd) {
+            fprintf(fp, ",%s,%" PRIu64 ",%.9f,%.9f", cd->codec, cd->records, cd->encode, cd->decode);
+        } else {
+            fprintf(fp, ",,,,");
+        }
+        fputc(',', fp);
+        if (peak > 0) fprintf(fp, "%.2f", 100 * bps / peak);
+        fputc('\n', fp);
+    } else {
+        fputc('{', fp);
+        for (size_t i = 0; i < nstr; i++) {
+            fprintf(fp, "\"%s\":", keys[i]);
+            result_put_string(fp, format, vals[i]);
+            fputc(',', fp);
+        }
+        fprintf(fp, "\"size\":%" PRIu64 ",\"elapsed_s\":%.9f,\"bytes_per_sec\":%.2f,\"mb_per_sec\":%.2f",
+                r->size, r->elapsed, bps, bps / 1e6);
+        if (peak > 0) fprintf(fp, ",\"pct_of_peak\":%.2f", 100 * bps / peak);
+        const ipc_latency_t *l = r->latency;
+        if (l) {
+            fprintf(fp, ",\"offered_rate\":%.1f,\"messages\":%" PRIu64 ",\"p50_us\":%.3f,\"p90_us\":%.3f,"
+                        "\"p99_us\":%.3f,\"p999_us\":%.3f,\"max_us\":%.3f",
+                    l->rate, l->count, l->p50 * 1e6, l->p90 * 1e6, l->p99 * 1e6, l->p999 * 1e6, l->max * 1e6);
+        }
+        const ipc_payload_t *pl = r->payload;
+        if (pl) {
+            fprintf(fp, ",\"pattern\":\"%s\"", pl->pattern);
+            if (pl->src_offset >= 0) fprintf(fp, ",\"src_offset\":%ld", pl->src_offset);
+            if (pl->dst_offset >= 0) fprintf(fp, ",\"dst_offset\":%ld", pl->dst_offset);
+        }
+        const ipc_codec_t *cd = r->codec;
+        if (cd) {
+            fprintf(fp, ",\"codec\":\"%s\",\"records\":%" PRIu64 ",\"encode_s\":%.9f,\"decode_s\":%.9f",
+                    cd->codec, cd->records, cd->encode, cd->decode);
+        }
+        fprintf(fp, "}\n");
+    }
+
+    if (fp != out) fclose(fp);
+    else fflush(fp);
+    return 0;
+}
+
+// Reading records back: one sample per record, in file order
+
+#define RESULT_MAX_FIELDS 32
+
+typedef struct {
+    char transport[64];
+    char group[128]; // transport plus the variant, e.g. "memcpy/zero/src+0"
+    uint64_t size;
+    double elapsed;  // Seconds
+    double bps;      // Bytes per second
+} result_sample_t;
+
+typedef struct {
+    result_sample_t *v;
+    size_t n;
+    size_t cap;
+} result_set_t;
+
+// Samples are compared within a group: the same transport, pattern,
+// payload offsets and codec.  Defaults (seq, not placed, no codec) are
+// left out of the name, so plain runs are grouped by transport alone.
+static inline void result_group_name(char *buf, size_t len, const char *transport, const char *pattern,
+                                     long src_offset, long dst_offset, const char *codec) {
+    size_t used = snprintf(buf, len, "%s", transport);
+    if (used < len && *pattern && strcmp(pattern, "seq") != 0) used += snprintf(buf + used, len - used, "/%s", pattern);
+    if (used < len && src_offset >= 0) used += snprintf(buf + used, len - used, "/src+%ld", src_offset);
+    if (used < len && dst_offset >= 0) used += snprintf(buf + used, len - used, "/dst+%ld", dst_offset);
+    if (used < len && *codec) snprintf(buf + used, len - used, "/%s", codec);
+}
+
+static inline int result_add_sample(result_set_t *set, const char *transport, const char *pattern,
+                                    long src_offset, long dst_offset, const char *codec,
+                                    uint64_t size, double elapsed, double bps) {
+    if (set->n == set->cap) {
+        size_t cap = set->cap ? set->cap * 2 : 256;
+        result_sample_t *v = realloc(set->v, cap * sizeof(*v));
+        if (!v) return -1;
+        set->v = v;
+        set->cap = cap;
+    }
+    result_sample_t *s = &set->v[set->n++];
+    snprintf(s->transport, sizeof(s->transport), "%s", transport);
+    result_group_name(s->group, sizeof(s->group), transport, pattern, src_offset, dst_offset, codec);
+    s->size = size;
+    s->elapsed = elapsed;
+    s->bps = bps;
+    return 0;
+}
+
+static inline void result_set_free(result_set_t *set) {
+    free(set->v);
+    set->v = NULL;
+    set->n = set->cap = 0;
+}
+
+// Finds "key": in a one-line JSON object and returns a pointer to its value
+static inline const char *result_json_value(const char *line, const char *key) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *p = strstr(line, pattern);
+    return p ? p + strlen(pattern) : NULL;
+}
+
+// Copies the string value of "key" into buf, or "" when there is none
+static inline void result_json_string(const char *line, const char *key, char *buf, size_t len) {
+    const char *v = result_json_value(line, key);
+    buf[0] = '\0';
+    if (!v || *v != '"') return;
+    size_t n = strcspn(v + 1, "\"");
+    if (n >= len) n = len - 1;
+    memcpy(buf, v + 1, n);
+    buf[n] = '\0';
+}
+
+// A numeric field that may be absent (or empty in CSV): -1 then
+static inline long result_offset(const char *v) {
+    return v && *v >= '0' && *v <= '9' ? strtol(v, NULL, 10) : -1;
+}
+
+// Splits a CSV line in place, honouring "quoted, fields" and "" escapes
+static inline int result_csv_split(char *line, char **fields, int max) {
+    int n = 0;
+    char *p = line;
+    while (n < max) {
+        char *out = p;
+        fields[n++] = p;
+        if (*p == '"') {
+            char *in = p + 1;
+            fields[n - 1] = out;
+            while (*in) {
+                if (in[0] == '"' && in[1] == '"') { *out++ = '"'; in += 2; }
+                else if (in[0] == '"') { in++; break; }
+                else *out++ = *in++;
+            }
+            p = in;
+        } else {
+            while (*p && *p != ',' && *p != '\n' && *p != '\r') p++;
+            out = p;
+        }
+        int more = *p == ',';
+        *out = '\0';
+        if (!more) break;
+        p++;
+    }
+    return n;
+}
+
+// Appends every record of a CSV or JSON-lines file to set
+static inline int result_load(const char *path, result_set_t *set) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+
+    char line[4096];
+    int col_transport = -1, col_size = -1, col_elapsed = -1, col_bps = -1;
+    int col_pattern = -1, col_src = -1, col_dst = -1, col_codec = -1;  // Optional
+
+    while (fgets(line, sizeof(line), fp)) {
+        if (line[0] == '{') {
+            char transport[64], pattern[16], codec[16];
+            result_json_string(line, "transport", transport, sizeof(transport));
+            result_json_string(line, "pattern", pattern, sizeof(pattern));
+            result_json_string(line, "codec", codec, sizeof(codec));
+            const char *sz = result_json_value(line, "size");
+            const char *e = result_json_value(line, "elapsed_s");
+            const char *b = result_json_value(line, "bytes_per_sec");
+            if (!transport[0] || !sz || !e || !b) continue;
+
+            if (result_add_sample(set, transport, pattern, result_offset(result_json_value(line, "src_offset")),
+                                  result_offset(result_json_value(line, "dst_offset")), codec,
+                                  strtoull(sz, NULL, 10), strtod(e, NULL), strtod(b, NULL)) < 0) break;
+            continue;
+        }
+
+        char *fields[RESULT_MAX_FIELDS];
+        int n = result_csv_split(line, fields, RESULT_MAX_FIELDS);
+        if (n > 0 && strcmp(fields[0], "timestamp") == 0) {
+            // Header row; files may hold several after concatenation
+            col_pattern = col_src = col_dst = col_codec = -1;
+            for (int i = 0; i < n; i++) {
+                if (strcmp(fields[i], "transport") == 0) col_transport = i;
+                else if (strcmp(fields[i], "size") == 0) col_size = i;
+                else if (strcmp(fields[i], "elapsed_s") == 0) col_elapsed = i;
+                else if (strcmp(fields[i], "bytes_per_sec") == 0) col_bps = i;
+                else if (strcmp(fields[i], "pattern") == 0) col_pattern = i;
+                else if (strcmp(fields[i], "src_offset") == 0) col_src = i;
+                else if (strcmp(fields[i], "dst_offset") == 0) col_dst = i;
+                else if (strcmp(fields[i], "codec") == 0) col_codec = i;
+            }
+            continue;
+        }
+        if (col_transport < 0 || col_size < 0 || col_elapsed < 0 || col_bps < 0) continue;
+        if (n <= col_transport || n <= col_size || n <= col_elapsed || n <= col_bps) continue;
+
+        const char *pattern = col_pattern >= 0 && n > col_pattern ? fields[col_pattern] : "";
+        const char *codec = col_codec >= 0 && n > col_codec ? fields[col_codec] : "";
+        long src = result_offset(col_src >= 0 && n > col_src ? fields[col_src] : NULL);
+        long dst = result_offset(col_dst >= 0 && n > col_dst ? fields[col_dst] : NULL);
+        if (result_add_sample(set, fields[col_transport], pattern, src, dst, codec,
+                              strtoull(fields[col_size], NULL, 10),
+                              strtod(fields[col_elapsed], NULL), strtod(fields[col_bps], NULL)) < 0) break;
+    }
+
+    fclose(fp);
+    return 0;
+}
+
+#endif // IPCRESULT_H
@@ -0,0 +1,89 @@
+//
+// ipcstream.h
+//
+// For questions/support: norman.mcentire@gmail.com
+//
+// 64-bit size parsing, the last-level cache size (for sizing buffers that
+// must miss in it) and the bounded-memory streaming mode.
+//
+// In streaming mode (--window BYTES) the logical payload is never
+// materialised.  It is the usual 0, 1, 2, ... byte pattern, which repeats
+// every 256 bytes, so one reference buffer of window + 256 bytes can serve
+// any window at any offset: the bytes for offset o start at ref + (o & 0xff).
+// Senders transmit straight from that buffer and receivers drain into a
+// single window, so memory stays constant whatever the logical size.
+//
+#ifndef IPCSTREAM_H
+#define IPCSTREAM_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include "crc32c.h"
+
+// Accepts a plain byte count or a K/M/G/T suffix (powers of 1024).
+// Returns 0 on success, -1 if the argument is not a valid size.
+static inline int parse_size(const char *arg, uint64_t *out) {
+    char *end;
+    errno = 0;
+    unsigned long long v = strtoull(arg, &end, 10);
+    if (errno || end == arg || arg[0] == '-') return -1;
+
+    int shift = 0;
+    switch (*end) {
+        case 'k': case 'K': shift = 10; end++; break;
+        case 'm': case 'M': shift = 20; end++; break;
+        case 'g': case 'G': shift = 30; end++; break;
+        case 't': case 'T': shift = 40; end++; break;
+    }
+    if (*end != '\0') return -1;
+    if (shift && v > (UINT64_MAX >> shift)) return -1;
+
+    *out = (uint64_t)v << shift;
+    return 0;
+}
+
+// Last-level cache size of cpu0 from sysfs, or 8 MB if it is not exposed
+static inline size_t llc_size(void) {
+    size_t best = 0;
+    for (int idx = 0; idx < 8; idx++) {
+        char path[128];
+        unsigned long kb;
+        char unit = 'K';
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu0/cache/index%d/size", idx);
+        FILE *fp = fopen(path, "r");
+        if (!fp) break;
+        if (fscanf(fp, "%lu%c", &kb, &unit) >= 1) {
+            size_t bytes = kb * (unit == 'M' ? 1024 * 1024 : 1024);
+            if (bytes > best) best = bytes;
+        }
+        fclose(fp);
+    }
+    return best ? best : 8 * 1024 * 1024;
+}
+
+static inline uint8_t *stream_pattern_alloc(size_t window) {
+    uint8_t *ref = malloc(window + 256);
+    if (!ref) return NULL;
+    for (size_t i = 0; i < window + 256; i++) {
+        ref[i] = (uint8_t)i;
+    }
+    return ref;
+}
+
+static inline const uint8_t *stream_pattern_at(const uint8_t *ref, uint64_t offset) {
+    return ref + (offset & 0xff);
+}
+
+// CRC32C of the whole logical payload, generated window by window
+static inline uint32_t stream_pattern_crc(const uint8_t *ref, uint64_t size, size_t window) {
+    uint32_t crc = 0;
+    for (uint64_t off = 0; off < size; off += window) {
+        size_t n = size - off < window ? (size_t)(size - off) : window;
+        crc = crc32c(crc, stream_pattern_at(ref, off), n);
+    }
+    return crc;
+}
+
+#endif // IPCSTREAM_H
@@ -0,0 +1,297 @@
+#!/bin/sh
+#
+# ipcsuite.sh
+#
+# For questions/support: norman.mcentire@gmail.com
+#
+# Regenerates the IPC timing report on the current machine in one command:
+# builds the tools, records the environment, runs every transport at every
+# size for a number of repetitions, and renders the results with ipcreport.
+#
+#   ./ipcsuite.sh [--out DIR] [--sizes "1K 64K 1M"] [--reps N]
+#                 [--transports "memcpy shm tcp"] [--cpus LIST] [--strict]
+#                 [--load "ipcload options"]
+#
+# Results are appended to DIR/results.csv (one record per run, see
+# ipcresult.h), tool output goes to DIR/run.log, and the report is written
+# to DIR/report.md (with DIR/report-*.svg) and DIR/report.html.
+#
+# Before the runs, streambw measures the machine's peak copy bandwidth and
+# exports it as IPC_PEAK_BPS, so every record also carries its throughput
+# as a percentage of that peak (pct_of_peak).  Set IPC_PEAK_BPS beforehand
+# to reuse an earlier measurement.
+#
+# The environment checks look at the frequency governor, turbo/boost and
+# isolated CPUs.  Each finding is recorded in DIR/env.txt and in the report;
+# with --strict any warning aborts the run before measuring.
+#
+# With --load, every transport and size is also run with ipcload in the
+# background (e.g. --load "--mem 2 --llc 1 --siblings-of 2,3") right after
+# its idle repetitions.  Those results go to DIR/results-load.csv and the
+# report adds the throughput change relative to idle.
+#
+
+OUT=ipcsuite-$(date +%Y%m%d-%H%M%S)
+SIZES="1K 4K 16K 32K 64K 256K 1M 4M 16M"
+REPS=10
+TRANSPORTS="memcpy shm cma-pull cma-push pipe fifo vmsplice posix-mq sysv-msg tcp udp zmq dbus-direct dbus-private"
+CPUS=
+STRICT=0
+LOAD=
+TIMEOUT=120
+CC=${CC:-gcc}
+
+usage() {
+    echo "Usage: $0 [--out DIR] [--sizes LIST] [--reps N] [--transports LIST] [--cpus LIST] [--strict] [--load OPTIONS]" >&2
+    exit 2
+}
+
+while [ $# -gt 0 ]; do
+    case "$1" in
+        --out) OUT=$2; shift 2 ;;
+        --sizes) SIZES=$2; shift 2 ;;
+        --reps) REPS=$2; shift 2 ;;
+        --transports) TRANSPORTS=$2; shift 2 ;;
+        --cpus) CPUS=$2; shift 2 ;;
+        --strict) STRICT=1; shift ;;
+        --load) LOAD=$2; shift 2 ;;
+        *) usage ;;
+    esac
+done
+
+case "$REPS" in
+    ''|*[!0-9]*|0) usage ;;
+esac
+
+SRC=$(cd "$(dirname "$0")" && pwd)
+mkdir -p "$OUT/bin" || exit 1
+CSV=$OUT/results.csv
+LOAD_CSV=$OUT/results-load.csv
+LOG=$OUT/run.log
+ENV=$OUT/env.txt
+WARNINGS=0
+
+# ---- Build ----------------------------------------------------------------
+
+build() {
+    name=$1
+    shift
+    if "$CC" -Wall -O2 "$SRC/$name.c" -o "$OUT/bin/$name" "$@" >>"$LOG" 2>&1; then
+        return 0
+    fi
+    echo "Build of $name failed; see $LOG" >&2
+    return 1
+}
+
+: >"$LOG"
+BUILT=
+for tool in memcpy shmemcpy cmamemcpy pipememcpy tcpmemcpy udpmemcpy; do
+    build $tool && BUILT="$BUILT $tool"
+done
+build mqmemcpy -lrt && BUILT="$BUILT mqmemcpy"
+build zmqmemcpy -lzmq && BUILT="$BUILT zmqmemcpy"
+build dbusmemcpy $(pkg-config --cflags --libs dbus-1 2>/dev/null) && BUILT="$BUILT dbusmemcpy"
+build ipcreport -lm || exit 1
+if [ -z "$IPC_PEAK_BPS" ]; then
+    build streambw -lpthread -lm || exit 1
+fi
+if [ -n "$LOAD" ]; then
+    build ipcload -lpthread || exit 1
+fi
+
+# ---- Environment ------------------------------------------------------------
+
+note() {
+    echo "$1" >>"$ENV"
+}
+
+warn() {
+    echo "WARNING: $1" | tee -a "$ENV" >&2
+    WARNINGS=$((WARNINGS + 1))
+}
+
+: >"$ENV"
+note "Date:       $(date -u +%Y-%m-%dT%H:%M:%SZ)"
+note "Host:       $(uname -n)"
+note "Kernel:     $(uname -srvm)"
+note "OS:         $(. /etc/os-release 2>/dev/null && echo "$PRETTY_NAME")"
+note "CPU:        $(grep -m1 -E '^(model name|Processor)' /proc/cpuinfo | cut -d: -f2- | sed 's/^ *//')"
+note "CPUs:       $(getconf _NPROCESSORS_ONLN)"
+note "Memory:     $(awk '/^MemTotal/ { printf "%.1f GB", $2 / 1048576 }' /proc/meminfo)"
+note "Compiler:   $("$CC" --version | head -n1)"
+note "Revision:   $(git -C "$SRC" describe --always --dirty 2>/dev/null || echo unknown)"
+note "Pinned to:  ${CPUS:-not pinned}"
+note "Load:       ${LOAD:-idle only}"
+
+# Governor: every online CPU should be at "performance"
+governors=$(cat /sys/devices/system/cpu/cpu[0-9]*/cpufreq/scaling_governor 2>/dev/null | sort -u | tr '\n' ' ')
+if [ -z "$governors" ]; then
+    note "Governor:   n/a (no cpufreq)"
+elif [ "$governors" = "performance " ]; then
+    note "Governor:   performance"
+else
+    note "Governor:   $governors"
+    warn "frequency governor is not 'performance' on every CPU"
+fi
+
+# Turbo: intel_pstate exposes no_turbo, acpi-cpufreq and others expose boost
+if [ -r /sys/devices/system/cpu/intel_pstate/no_turbo ]; then
+    if [ "$(cat /sys/devices/system/cpu/intel_pstate/no_turbo)" = 1 ]; then
+        note "Turbo:      disabled"
+    else
+        note "Turbo:      enabled"
+        warn "turbo is enabled (echo 1 > /sys/devices/system/cpu/intel_pstate/no_turbo)"
+    fi
+elif [ -r /sys/devices/system/cpu/cpufreq/boost ]; then
+    if [ "$(cat /sys/devices/system/cpu/cpufreq/boost)" = 0 ]; then
+        note "Turbo:      disabled"
+    else
+        note "Turbo:      enabled"
+        warn "boost is enabled (echo 0 > /sys/devices/system/cpu/cpufreq/boost)"
+    fi
+else
+    note "Turbo:      n/a"
+fi
+
+# Isolation: the measuring CPUs should be in isolcpus
+isolated=$(cat /sys/devices/system/cpu/isolated 2>/dev/null)
+note "Isolated:   ${isolated:-none}"
+if [ -z "$isolated" ]; then
+    warn "no isolated CPUs (boot with isolcpus= and pass --cpus)"
+elif [ -z "$CPUS" ]; then
+    warn "CPUs $isolated are isolated but --cpus was not given"
+fi
+
+# Peak copy bandwidth over the same CPUs the transports will use
+if [ -z "$IPC_PEAK_BPS" ]; then
+    echo "Measuring memory bandwidth..." >&2
+    PIN_STREAM=
+    if [ -n "$CPUS" ]; then
+        PIN_STREAM="taskset -c $CPUS"
+    fi
+    IPC_PEAK_BPS=$($PIN_STREAM "$OUT/bin/streambw" --verify --format csv --output "$OUT/stream.csv" 2>>"$LOG" |
+        tee -a "$LOG" | awk '/^\[Stream\] Peak copy:/ { print $4 }')
+fi
+if [ -n "$IPC_PEAK_BPS" ]; then
+    export IPC_PEAK_BPS
+    note "Peak copy:  $(awk -v b="$IPC_PEAK_BPS" 'BEGIN { printf "%.2f MB/sec", b / 1e6 }') (streambw, bytes copied)"
+else
+    warn "memory bandwidth could not be measured; no percentage of peak"
+fi
+
+if [ "$STRICT" = 1 ] && [ "$WARNINGS" -gt 0 ]; then
+    echo "Environment checks failed (--strict); see $ENV" >&2
+    exit 1
+fi
+
+# ---- Matrix -------------------------------------------------------------------
+
+PIN=
+if [ -n "$CPUS" ]; then
+    PIN="taskset -c $CPUS"
+fi
+
+# Maps a transport name to its command line; returns 1 if it is unavailable
+command_for() {
+    case "$1" in
+        memcpy) tool=memcpy; args= ;;
+        shm) tool=shmemcpy; args= ;;
+        cma-pull) tool=cmamemcpy; args="--mode pull" ;;
+        cma-push) tool=cmamemcpy; args="--mode push" ;;
+        pipe|fifo|vmsplice) tool=pipememcpy; args="--mode $1" ;;
+        posix-mq) tool=mqmemcpy; args="--api posix" ;;
+        posix-mq-notify) tool=mqmemcpy; args="--api posix --notify" ;;
+        sysv-msg) tool=mqmemcpy; args="--api sysv" ;;
+        tcp) tool=tcpmemcpy; args= ;;
+        udp) tool=udpmemcpy; args= ;;
+        zmq) tool=zmqmemcpy; args= ;;
+        dbus-direct) tool=dbusmemcpy; args="--mode direct" ;;
+        dbus-private) tool=dbusmemcpy; args="--private-bus" ;;
+        dbus-bus) tool=dbusmemcpy; args="--mode bus" ;;
+        *) echo "Unknown transport $1" >&2; return 1 ;;
+    esac
+    case " $BUILT " in
+        *" $tool "*) ;;
+        *) return 1 ;;
+    esac
+    CMD="$PIN $OUT/bin/$tool $args"
+}
+
+# Sizes the transport cannot carry in one message are skipped, not failed
+size_ok() {
+    case "$1" in
+        # One datagram: 65507 bytes less udpmemcpy's 48-byte header (LP64)
+        udp) [ "$2" -le $((65507 - 48)) ] ;;
+        *) true ;;
+    esac
+}
+
+# K/M/G suffixes to bytes, matching parse_size() in ipcstream.h
+bytes() {
+    case "$1" in
+        *[kK]) echo $(( ${1%?} * 1024 )) ;;
+        *[mM]) echo $(( ${1%?} * 1024 * 1024 )) ;;
+        *[gG]) echo $(( ${1%?} * 1024 * 1024 * 1024 )) ;;
+        *) echo "$1" ;;
+    esac
+}
+
+# Runs one transport at one size REPS times, appending to the given CSV
+run_reps() {
+    rep=1
+    while [ "$rep" -le "$REPS" ]; do
+        echo "== $transport size $size rep $rep$2" >>"$LOG"
+        if timeout "$TIMEOUT" $CMD --size "$size" --verify --format csv --output "$1" >>"$LOG" 2>&1; then
+            printf '.'
+        else
+            printf 'x'
+            FAILED=$((FAILED + 1))
+        fi
+        rep=$((rep + 1))
+    done
+}
+
+FAILED=0
+for transport in $TRANSPORTS; do
+    if ! command_for "$transport"; then
+        echo "Skipping $transport (not built)" >&2
+        continue
+    fi
+    for size in $SIZES; do
+        if ! size_ok "$transport" "$(bytes "$size")"; then
+            echo "Skipping $transport at $size (too large)" >>"$LOG"
+            continue
+        fi
+        printf '%-14s %6s ' "$transport" "$size"
+        run_reps "$CSV" ""
+        if [ -n "$LOAD" ]; then
+            # Give the hogs a moment to allocate and reach steady state
+            "$OUT/bin/ipcload" $LOAD >>"$LOG" 2>&1 &
+            load_pid=$!
+            sleep 1
+            printf ' '
+            run_reps "$LOAD_CSV" " (load)"
+            kill "$load_pid"
+            wait "$load_pid"
+        fi
+        echo
+    done
+done
+
+if [ ! -s "$CSV" ]; then
+    echo "No results were recorded; see $LOG" >&2
+    exit 1
+fi
+
+# ---- Report -------------------------------------------------------------------
+
+TITLE="IPC Timings: $(uname -n) $(uname -m), $(date +%Y-%m-%d)"
+set --
+if [ -s "$LOAD_CSV" ]; then
+    set -- --load "$LOAD_CSV"
+fi
+"$OUT/bin/ipcreport" --title "$TITLE" --env "$ENV" "$@" \
+    --markdown "$OUT/report.md" --html "$OUT/report.html" "$CSV" || exit 1
+
+echo "Report: $OUT/report.md, $OUT/report.html ($FAILED failed runs, $WARNINGS environment warnings)"
+[ "$FAILED" -eq 0 ]
@@ -0,0 +1,147 @@
+//
+// ipctrace.h
+//
+// For questions/support: norman.mcentire@gmail.com
+//
+// In-band phase tracing for the parent/child transfer tools.
+//
+// The trace lives in an anonymous shared mapping created before fork().
+// It holds one fixed-size event buffer per process; each side appends
+// only to its own buffer, so no locking is needed.  After wait() the
+// parent merges both buffers and prints a per-phase table and/or writes
+// Chrome trace JSON (load it in chrome://tracing or ui.perfetto.dev).
+//
+// Timestamps are CLOCK_MONOTONIC, which both processes share, so events
+// from the two sides line up on one timeline.  Every call accepts a NULL
+// trace and does nothing, so call sites need no extra checks.
+//
+#ifndef IPCTRACE_H
+#define IPCTRACE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+
+#define IPC_TRACE_MAX_EVENTS 64
+#define IPC_TRACE_NAME_LEN   24
+
+enum { IPC_TRACE_PARENT = 0, IPC_TRACE_CHILD = 1, IPC_TRACE_SIDES = 2 };
+
+typedef struct {
+    uint64_t ns;
+    char name[IPC_TRACE_NAME_LEN];
+} ipc_trace_event_t;
+
+typedef struct {
+    pid_t pid[IPC_TRACE_SIDES];
+    uint32_t count[IPC_TRACE_SIDES];
+    ipc_trace_event_t events[IPC_TRACE_SIDES][IPC_TRACE_MAX_EVENTS];
+} ipc_trace_t;
+
+static const char *ipc_trace_side_name[IPC_TRACE_SIDES] = { "Parent", "Child" };
+
+// Call before fork(); returns NULL on failure
+static ipc_trace_t *ipc_trace_create(void) {
+    ipc_trace_t *trace = mmap(NULL, sizeof(ipc_trace_t), PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (trace == MAP_FAILED) {
+        perror("ipc_trace mmap");
+        return NULL;
+    }
+    memset(trace, 0, sizeof(*trace));
+    return trace;
+}
+
+static void ipc_trace_destroy(ipc_trace_t *trace) {
+    if (trace) munmap(trace, sizeof(ipc_trace_t));
+}
+
+static inline void ipc_trace_mark(ipc_trace_t *trace, int side, const char *name) {
+    if (!trace) return;
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    uint32_t n = trace->count[side];
+    if (n >= IPC_TRACE_MAX_EVENTS) return;  // Buffer full: drop, never block
+
+    trace->events[side][n].ns = (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    strncpy(trace->events[side][n].name, name, IPC_TRACE_NAME_LEN - 1);
+    trace->pid[side] = getpid();
+    trace->count[side] = n + 1;
+}
+
+// Merge both sides into time order; returns the number of events
+static size_t ipc_trace_merge(const ipc_trace_t *trace, const ipc_trace_event_t **out, int *side) {
+    uint32_t i[IPC_TRACE_SIDES] = { 0, 0 };
+    size_t n = 0;
+
+    while (i[0] < trace->count[0] || i[1] < trace->count[1]) {
+        int s;
+        if (i[0] >= trace->count[0]) s = 1;
+        else if (i[1] >= trace->count[1]) s = 0;
+        else s = trace->events[1][i[1]].ns < trace->events[0][i[0]].ns;
+
+        out[n] = &trace->events[s][i[s]++];
+        side[n] = s;
+        n++;
+    }
+    return n;
+}
+
+static void ipc_trace_print_table(const ipc_trace_t *trace) {
+    if (!trace) return;
+
+    const ipc_trace_event_t *ev[IPC_TRACE_SIDES * IPC_TRACE_MAX_EVENTS];
+    int side[IPC_TRACE_SIDES * IPC_TRACE_MAX_EVENTS];
+    size_t n = ipc_trace_merge(trace, ev, side);
+    if (n == 0) return;
+
+    printf("[Trace] %-8s %-24s %14s %14s\n", "Side", "Phase", "Since first us", "Phase us");
+    for (size_t k = 0; k < n; k++) {
+        double since = (ev[k]->ns - ev[0]->ns) / 1e3;
+        double phase = k > 0 ? (ev[k]->ns - ev[k - 1]->ns) / 1e3 : 0.0;
+        printf("[Trace] %-8s %-24s %14.3f %14.3f\n",
+               ipc_trace_side_name[side[k]], ev[k]->name, since, phase);
+    }
+}
+
+// Each phase becomes a complete ("X") event spanning from the previous
+// mark to its own, on the track of the process that recorded it.
+static int ipc_trace_write_chrome(const ipc_trace_t *trace, const char *path) {
+    if (!trace) return 0;
+
+    FILE *fp = fopen(path, "w");
+    if (!fp) {
+        perror(path);
+        return -1;
+    }
+
+    const ipc_trace_event_t *ev[IPC_TRACE_SIDES * IPC_TRACE_MAX_EVENTS];
+    int side[IPC_TRACE_SIDES * IPC_TRACE_MAX_EVENTS];
+    size_t n = ipc_trace_merge(trace, ev, side);
+
+    fprintf(fp, "[\n");
+    for (int s = 0; s < IPC_TRACE_SIDES; s++) {
+        fprintf(fp, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,"
+                    "\"args\":{\"name\":\"%s\"}}%s\n",
+                (int)trace->pid[s], (int)trace->pid[s], ipc_trace_side_name[s],
+                (s + 1 < IPC_TRACE_SIDES || n > 0) ? "," : "");
+    }
+    for (size_t k = 0; k < n; k++) {
+        uint64_t begin = k > 0 ? ev[k - 1]->ns : ev[k]->ns;
+        fprintf(fp, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,"
+                    "\"ts\":%.3f,\"dur\":%.3f}%s\n",
+                ev[k]->name, (int)trace->pid[side[k]], (int)trace->pid[side[k]],
+                begin / 1e3, (ev[k]->ns - begin) / 1e3, k + 1 < n ? "," : "");
+    }
+    fprintf(fp, "]\n");
+    fclose(fp);
+    return 0;
+}
+
+#endif // IPCTRACE_H
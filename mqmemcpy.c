@@ -0,0 +1,507 @@
+//
+// mqmemcpy.c
+//
+// For questions/support: norman.mcentire@gmail.com
+//
+// To build: gcc -Wall mqmemcpy.c -o mqmemcpy -lrt
+//
+// Moves buf_data_t from parent to child through a kernel message queue:
+//
+//   --api posix  mq_open/mq_send/mq_receive; --maxmsg and --msgsize set
+//                mq_maxmsg and mq_msgsize, and --notify waits for
+//                mq_notify() signals instead of blocking in mq_receive()
+//   --api sysv   msgget/msgsnd/msgrcv; --msgsize is the segment size (at
+//                most kernel.msgmax) and --maxmsg raises msg_qbytes to
+//                maxmsg * msgsize
+//
+// Payloads larger than one message are split into msgsize segments and
+// reassembled by the receiver.  Unprivileged callers are limited by
+// /proc/sys/fs/mqueue/{msg_max,msgsize_max} and kernel.msgmax/msgmnb.
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <getopt.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <mqueue.h>
+#include <sys/ipc.h>
+#include <sys/msg.h>
+#include <poll.h>
+#include "perfcount.h"
+#include "crc32c.h"
+#include "ipcstream.h"
+#include "ipcresult.h"
+#include "ipctrace.h"
+
+#define MQ_NAME_FMT "/mqmemcpy-%d"
+#define MSG_TYPE 1
+
+enum { API_POSIX = 0, API_SYSV };
+
+typedef struct {
+    struct timeval start;
+    struct timeval end;
+    uint64_t size;
+    uint32_t crc;       // CRC32C of data[], set by the sender with --verify
+    uint8_t data[];
+} buf_data_t;
+
+// msgsnd/msgrcv need the type immediately before the text, so SysV
+// segments go through a staging buffer in both processes
+typedef struct {
+    long mtype;
+    char mtext[];
+} sysv_msg_t;
+
+volatile sig_atomic_t sigusr1_received = 0;
+
+void handle_sigusr1(int sig) {
+    sigusr1_received = 1;
+}
+
+// Sends [buf, buf + count) as consecutive messages of at most msgsize bytes
+int posix_send(mqd_t mq, const void *buf, size_t count, size_t msgsize) {
+    for (size_t off = 0; off < count; off += msgsize) {
+        size_t n = count - off < msgsize ? count - off : msgsize;
+        if (mq_send(mq, (const char *)buf + off, n, 0) < 0) return -1;
+    }
+    return 0;
+}
+
+// mq_receive() needs room for a full message, so segments that would not
+// fit in what is left of buf land in the staging buffer first
+ssize_t posix_receive_one(mqd_t mq, char *dst, size_t room, char *stage, size_t msgsize) {
+    if (room >= msgsize) return mq_receive(mq, dst, msgsize, NULL);
+
+    ssize_t n = mq_receive(mq, stage, msgsize, NULL);
+    if (n > 0 && (size_t)n > room) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+    if (n > 0) memcpy(dst, stage, n);
+    return n;
+}
+
+// With notify, the queue is non-blocking and an empty queue arms
+// mq_notify(SIGUSR2).  Notification only fires on an empty to non-empty
+// transition, so the queue is drained once more after arming.
+int posix_receive(mqd_t mq, void *buf, size_t count, size_t msgsize, int notify,
+                  ipc_trace_t *trace) {
+    char *stage = malloc(msgsize);
+    if (!stage) return -1;
+
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGUSR2);
+    struct sigevent sev = { .sigev_notify = SIGEV_SIGNAL, .sigev_signo = SIGUSR2 };
+    int armed = 0;
+
+    size_t got = 0;
+    while (got < count) {
+        ssize_t n = posix_receive_one(mq, (char *)buf + got, count - got, stage, msgsize);
+        if (n < 0 && notify && errno == EAGAIN) {
+            if (!armed) {
+                if (mq_notify(mq, &sev) < 0) break;
+                armed = 1;
+                continue;
+            }
+            int sig;
+            sigwait(&set, &sig);
+            armed = 0;
+            continue;
+        }
+        if (n <= 0) break;
+        if (got == 0) ipc_trace_mark(trace, IPC_TRACE_CHILD, "first chunk");
+        got += n;
+    }
+    ipc_trace_mark(trace, IPC_TRACE_CHILD, "last chunk");
+
+    free(stage);
+    return got == count ? 0 : -1;
+}
+
+// First number in a /proc file, or def if it cannot be read
+long read_limit(const char *path, long def) {
+    long v = def;
+    FILE *fp = fopen(path, "r");
+    if (fp) {
+        if (fscanf(fp, "%ld", &v) != 1) v = def;
+        fclose(fp);
+    }
+    return v;
+}
+
+int sysv_send(int qid, const void *buf, size_t count, size_t msgsize) {
+    sysv_msg_t *msg = malloc(sizeof(sysv_msg_t) + msgsize);
+    if (!msg) return -1;
+    msg->mtype = MSG_TYPE;
+
+    int rc = 0;
+    for (size_t off = 0; off < count && rc == 0; off += msgsize) {
+        size_t n = count - off < msgsize ? count - off : msgsize;
+        memcpy(msg->mtext, (const char *)buf + off, n);
+        if (msgsnd(qid, msg, n, 0) < 0) rc = -1;
+    }
+    free(msg);
+    return rc;
+}
+
+int sysv_receive(int qid, void *buf, size_t count, size_t msgsize, ipc_trace_t *trace) {
+    sysv_msg_t *msg = malloc(sizeof(sysv_msg_t) + msgsize);
+    if (!msg) return -1;
+
+    size_t got = 0;
+    while (got < count) {
+        ssize_t n = msgrcv(qid, msg, msgsize, MSG_TYPE, 0);
+        if (n <= 0 || (size_t)n > count - got) break;
+        if (got == 0) ipc_trace_mark(trace, IPC_TRACE_CHILD, "first chunk");
+        memcpy((char *)buf + got, msg->mtext, n);
+        got += n;
+    }
+    ipc_trace_mark(trace, IPC_TRACE_CHILD, "last chunk");
+
+    free(msg);
+    return got == count ? 0 : -1;
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t size = 0;
+    int perf = 0;
+    int trace_table = 0;
+    const char *trace_json = NULL;
+    int verify = 0;  // 1: checksum outside the timed region, 2: inside
+    int api = API_POSIX;
+    long maxmsg = 0;        // 0 keeps the system default
+    uint64_t msgsize = 0;   // 0 keeps the system default
+    int notify = 0;
+    int format = RESULT_TEXT;
+    const char *output = NULL;  // Append records here instead of stdout
+
+    static struct option long_options[] = {
+        {"size", required_argument, 0, 's'},
+        {"perf", no_argument, 0, 'P'},
+        {"trace", no_argument, 0, 'T'},
+        {"trace-json", required_argument, 0, 'J'},
+        {"verify", no_argument, 0, 'V'},
+        {"verify-timed", no_argument, 0, 'I'},
+        {"api", required_argument, 0, 'a'},
+        {"maxmsg", required_argument, 0, 'n'},
+        {"msgsize", required_argument, 0, 'm'},
+        {"notify", no_argument, 0, 'N'},
+        {"format", required_argument, 0, 'f'},
+        {"output", required_argument, 0, 'o'},
+        {0, 0, 0, 0}
+    };
+
+    while (1) {
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "s:PTJ:VIa:n:m:Nf:o:", long_options, &option_index);
+        if (c == -1) break;
+
+        switch (c) {
+            case 's':
+                if (parse_size(optarg, &size) < 0) {
+                    fprintf(stderr, "Invalid size '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'P':
+                perf = 1;
+                break;
+            case 'T':
+                trace_table = 1;
+                break;
+            case 'J':
+                trace_json = optarg;
+                break;
+            case 'V':
+                verify = 1;
+                break;
+            case 'I':
+                verify = 2;
+                break;
+            case 'a':
+                if (strcmp(optarg, "posix") == 0) api = API_POSIX;
+                else if (strcmp(optarg, "sysv") == 0) api = API_SYSV;
+                else {
+                    fprintf(stderr, "Invalid api '%s' (expected posix or sysv).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'n':
+                maxmsg = atol(optarg);
+                if (maxmsg <= 0) {
+                    fprintf(stderr, "Invalid maxmsg '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'm':
+                if (parse_size(optarg, &msgsize) < 0 || msgsize == 0 || msgsize > INT32_MAX) {
+                    fprintf(stderr, "Invalid msgsize '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'N':
+                notify = 1;
+                break;
+            case 'f':
+                format = result_format_parse(optarg);
+                if (format < 0) {
+                    fprintf(stderr, "Invalid format '%s' (expected text, json or csv).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s --size NUMBER [--api posix|sysv] [--maxmsg N] [--msgsize BYTES] [--notify] [--perf] [--trace] [--trace-json FILE] [--verify|--verify-timed] [--format text|json|csv] [--output FILE]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    result_redirect_text(format, output);
+
+    if (size == 0) {
+        fprintf(stderr, "Invalid size specified.\n");
+        return EXIT_FAILURE;
+    }
+    if (notify && api != API_POSIX) {
+        fprintf(stderr, "--notify needs --api posix.\n");
+        return EXIT_FAILURE;
+    }
+
+    size_t total_size = sizeof(buf_data_t) + size;
+
+    buf_data_t *src = malloc(total_size);
+    if (!src) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    src->size = size;
+    for (uint64_t i = 0; i < size; i++) {
+        src->data[i] = (uint8_t)i;
+    }
+
+    // Both queues exist before fork, so either side may start first
+    char mq_name[64];
+    mqd_t mq = (mqd_t)-1;
+    int qid = -1;
+    long qmaxmsg;
+    if (api == API_POSIX) {
+        snprintf(mq_name, sizeof(mq_name), MQ_NAME_FMT, getpid());
+        mq_unlink(mq_name);
+
+        // mq_open() takes both attributes or neither, so fill in the defaults
+        struct mq_attr attr = { 0 };
+        attr.mq_maxmsg = maxmsg ? maxmsg : read_limit("/proc/sys/fs/mqueue/msg_default", 10);
+        attr.mq_msgsize = msgsize ? (long)msgsize : read_limit("/proc/sys/fs/mqueue/msgsize_default", 8192);
+        mq = mq_open(mq_name, O_RDWR | O_CREAT | O_EXCL, 0600, &attr);
+        if (mq == (mqd_t)-1) {
+            perror("mq_open (see /proc/sys/fs/mqueue/msg_max and msgsize_max)");
+            free(src);
+            return EXIT_FAILURE;
+        }
+        mq_getattr(mq, &attr);
+        msgsize = attr.mq_msgsize;
+        qmaxmsg = attr.mq_maxmsg;
+    } else {
+        qid = msgget(IPC_PRIVATE, IPC_CREAT | 0600);
+        if (qid < 0) {
+            perror("msgget");
+            free(src);
+            return EXIT_FAILURE;
+        }
+
+        long msgmax = read_limit("/proc/sys/kernel/msgmax", 8192);
+        if (!msgsize) msgsize = msgmax;
+        if (msgsize > (uint64_t)msgmax) {
+            fprintf(stderr, "msgsize exceeds kernel.msgmax (%ld bytes).\n", msgmax);
+            msgctl(qid, IPC_RMID, NULL);
+            free(src);
+            return EXIT_FAILURE;
+        }
+
+        struct msqid_ds ds;
+        msgctl(qid, IPC_STAT, &ds);
+        if (maxmsg) {
+            ds.msg_qbytes = maxmsg * msgsize;
+            if (msgctl(qid, IPC_SET, &ds) < 0) {
+                perror("msgctl IPC_SET (see kernel.msgmnb)");
+                msgctl(qid, IPC_RMID, NULL);
+                free(src);
+                return EXIT_FAILURE;
+            }
+        }
+        qmaxmsg = ds.msg_qbytes / msgsize;
+    }
+
+    // Shared between parent and child, so it must exist before fork
+    ipc_trace_t *trace = NULL;
+    if (trace_table || trace_json) trace = ipc_trace_create();
+
+    // Install before fork so the child's ready signal cannot arrive first
+    signal(SIGUSR1, handle_sigusr1);
+
+    // Blocked in both processes; the notify receiver collects it with sigwait()
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR2);
+    sigprocmask(SIG_BLOCK, &mask, NULL);
+
+    pid_t child_pid = fork();
+    if (child_pid < 0) {
+        perror("fork");
+        free(src);
+        return EXIT_FAILURE;
+    }
+
+    if (child_pid == 0) {
+        // --- Child Process (Receiver) ---
+        buf_data_t *dst = malloc(total_size);
+        if (!dst) {
+            perror("Child malloc");
+            exit(EXIT_FAILURE);
+        }
+
+        // O_NONBLOCK belongs to the open description shared with the
+        // parent across fork, so the receiver opens its own
+        if (api == API_POSIX) {
+            mq_close(mq);
+            mq = mq_open(mq_name, O_RDONLY | (notify ? O_NONBLOCK : 0));
+            if (mq == (mqd_t)-1) {
+                perror("Child mq_open");
+                free(dst);
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        perf_counters_t pc;
+        if (perf) perf_counters_open(&pc);
+        if (perf) perf_counters_start(&pc);
+
+        kill(getppid(), SIGUSR1); // Notify parent
+
+        // Only when tracing: separate the wakeup from the first receive.
+        // A POSIX mqd_t is a file descriptor on Linux; SysV queues cannot be polled.
+        if (trace && api == API_POSIX) {
+            struct pollfd pfd = { .fd = (int)mq, .events = POLLIN };
+            poll(&pfd, 1, -1);
+            ipc_trace_mark(trace, IPC_TRACE_CHILD, "receiver wakeup");
+        }
+
+        int failed;
+        if (api == API_POSIX) {
+            failed = posix_receive(mq, dst, total_size, msgsize, notify, trace) < 0;
+        } else {
+            failed = sysv_receive(qid, dst, total_size, msgsize, trace) < 0;
+        }
+        if (failed) {
+            perror("Child: Failed to receive complete buffer");
+            free(dst);
+            exit(EXIT_FAILURE);
+        }
+
+        uint32_t crc = 0;
+        if (verify == 2) crc = crc32c(0, dst->data, size);
+
+        gettimeofday(&dst->end, NULL);
+        if (perf) perf_counters_stop(&pc);
+
+        if (verify == 1) crc = crc32c(0, dst->data, size);
+
+        long sec = dst->end.tv_sec - dst->start.tv_sec;
+        long usec = dst->end.tv_usec - dst->start.tv_usec;
+        if (usec < 0) {
+            sec--;
+            usec += 1000000;
+        }
+
+        double elapsed = sec + usec / 1e6;
+        double bps = elapsed > 0 ? (dst->size / elapsed) : 0;
+        double mbps = bps / 1e6;
+        uint64_t segments = (total_size + msgsize - 1) / msgsize;
+
+        printf("[Child] Elapsed Time: %.6f seconds\n", elapsed);
+        printf("[Child] Transferred:  %" PRIu64 " bytes\n", dst->size);
+        printf("[Child] Throughput:   %.2f bytes/sec (%.2f MB/sec)\n", bps, mbps);
+        result_print_peak("[Child] ", bps);
+        printf("[Child] Segments:     %" PRIu64 " x %" PRIu64 " bytes, queue depth %ld (%s%s)\n",
+               segments, msgsize, qmaxmsg, api == API_POSIX ? "posix" : "sysv",
+               notify ? ", mq_notify" : "");
+        ipc_trace_mark(trace, IPC_TRACE_CHILD, "post-processing");
+        if (perf) {
+            perf_counters_print(&pc, "[Child] ");
+            perf_counters_close(&pc);
+        }
+
+        int ok = !verify || (crc32c_report_size("[Child] ", size, dst->size) == 0 &&
+                                crc32c_report("[Child] ", dst->crc, crc) == 0);
+
+        ipc_result_t result = { api == API_POSIX ? (notify ? "posix-mq-notify" : "posix-mq") : "sysv-msg",
+                                dst->size, elapsed, verify ? ok : -1 };
+        result_emit(format, output, &result);
+
+        free(dst);
+        exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+    } else {
+        // --- Parent Process (Sender) ---
+        while (!sigusr1_received) pause();
+
+        if (verify == 1) src->crc = crc32c(0, src->data, size);
+
+        perf_counters_t pc;
+        if (perf) perf_counters_open(&pc);
+
+        if (perf) perf_counters_start(&pc);
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "pre-send");
+        gettimeofday(&src->start, NULL);
+
+        if (verify == 2) src->crc = crc32c(0, src->data, size);
+
+        int failed;
+        if (api == API_POSIX) {
+            failed = posix_send(mq, src, total_size, msgsize) < 0;
+        } else {
+            failed = sysv_send(qid, src, total_size, msgsize) < 0;
+        }
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "send return");
+        if (failed) {
+            // The receiver would wait for the missing segments forever
+            perror("Parent: Failed to send complete buffer");
+            kill(child_pid, SIGTERM);
+        }
+        if (perf) perf_counters_stop(&pc);
+
+        int status;
+        wait(&status);
+        if (perf) {
+            perf_counters_print(&pc, "[Parent] ");
+            perf_counters_close(&pc);
+        }
+
+        if (api == API_POSIX) {
+            mq_close(mq);
+            mq_unlink(mq_name);
+        } else {
+            msgctl(qid, IPC_RMID, NULL);
+        }
+
+        if (trace_table) ipc_trace_print_table(trace);
+        if (trace_json) ipc_trace_write_chrome(trace, trace_json);
+        ipc_trace_destroy(trace);
+        free(src);
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,145 @@
+//
+// perfcount.h
+//
+// For questions/support: norman.mcentire@gmail.com
+//
+// Optional perf_event_open counters wrapped around a timed region.
+// Header-only so every tool keeps its single-file build line.
+//
+// Counters are opened per process (pid 0, any CPU) after fork(), so the
+// parent and child each count only their own side of the transfer.
+// Counters the kernel or hypervisor does not expose are reported as n/a.
+//
+#ifndef PERFCOUNT_H
+#define PERFCOUNT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define PERF_NCOUNTERS 7
+
+typedef struct {
+    int fd[PERF_NCOUNTERS];
+    uint64_t value[PERF_NCOUNTERS];
+    int user_only;  // Kernel counting refused (perf_event_paranoid)
+} perf_counters_t;
+
+static const struct {
+    const char *label;
+    uint32_t type;
+    uint64_t config;
+} perf_counter_defs[PERF_NCOUNTERS] = {
+    { "Cycles:",       PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "Instructions:", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "LLC Misses:",   PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL |
+                                           (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { "dTLB Misses:",  PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+                                           (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                           (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) },
+    { "Page Faults:",  PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS },
+    { "Ctx Switches:", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES },
+    { "Migrations:",   PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CPU_MIGRATIONS },
+};
+
+static int perf_event_open_counter(uint32_t type, uint64_t config, int exclude_kernel) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = 1;
+    attr.exclude_kernel = exclude_kernel;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// Returns the number of counters that could be opened
+static int perf_counters_open(perf_counters_t *pc) {
+    int opened = 0;
+    memset(pc, 0, sizeof(*pc));
+
+    for (int i = 0; i < PERF_NCOUNTERS; i++) {
+        pc->fd[i] = perf_event_open_counter(perf_counter_defs[i].type,
+                                            perf_counter_defs[i].config, pc->user_only);
+        if (pc->fd[i] < 0 && errno == EACCES && !pc->user_only) {
+            // Unprivileged: restart with user-space only for every counter
+            // so all values cover the same privilege levels
+            for (int j = 0; j < i; j++) {
+                if (pc->fd[j] >= 0) close(pc->fd[j]);
+            }
+            pc->user_only = 1;
+            opened = 0;
+            i = -1;
+            continue;
+        }
+        if (pc->fd[i] >= 0) opened++;
+    }
+
+    if (opened == 0) {
+        fprintf(stderr, "perf_event_open: %s (counters unavailable)\n", strerror(errno));
+    }
+    return opened;
+}
+
+static void perf_counters_start(perf_counters_t *pc) {
+    for (int i = 0; i < PERF_NCOUNTERS; i++) {
+        if (pc->fd[i] < 0) continue;
+        ioctl(pc->fd[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(pc->fd[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+static void perf_counters_stop(perf_counters_t *pc) {
+    for (int i = 0; i < PERF_NCOUNTERS; i++) {
+        if (pc->fd[i] < 0) continue;
+        ioctl(pc->fd[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+
+    for (int i = 0; i < PERF_NCOUNTERS; i++) {
+        uint64_t buf[3];  // value, time enabled, time running
+        if (pc->fd[i] < 0 || read(pc->fd[i], buf, sizeof(buf)) != sizeof(buf)) {
+            pc->value[i] = 0;
+            continue;
+        }
+        // Scale up if the PMU multiplexed this counter
+        if (buf[2] > 0 && buf[2] < buf[1]) {
+            buf[0] = (uint64_t)((double)buf[0] * buf[1] / buf[2]);
+        }
+        pc->value[i] = buf[0];
+    }
+}
+
+// prefix is e.g. "[Child] "; pass "" for single-process tools
+static void perf_counters_print(const perf_counters_t *pc, const char *prefix) {
+    for (int i = 0; i < PERF_NCOUNTERS; i++) {
+        if (pc->fd[i] < 0) {
+            printf("%s%-14sn/a\n", prefix, perf_counter_defs[i].label);
+        } else if (i == 1 && pc->fd[0] >= 0 && pc->value[0] > 0) {
+            printf("%s%-14s%llu (%.2f IPC)\n", prefix, perf_counter_defs[i].label,
+                   (unsigned long long)pc->value[i], (double)pc->value[1] / pc->value[0]);
+        } else {
+            printf("%s%-14s%llu\n", prefix, perf_counter_defs[i].label,
+                   (unsigned long long)pc->value[i]);
+        }
+    }
+    if (pc->user_only) {
+        printf("%s%-14suser space only\n", prefix, "Counting:");
+    }
+}
+
+static void perf_counters_close(perf_counters_t *pc) {
+    for (int i = 0; i < PERF_NCOUNTERS; i++) {
+        if (pc->fd[i] >= 0) close(pc->fd[i]);
+        pc->fd[i] = -1;
+    }
+}
+
+#endif // PERFCOUNT_H
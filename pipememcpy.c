@@ -0,0 +1,411 @@
+//
+// pipememcpy.c
+//
+// For questions/support: norman.mcentire@gmail.com
+//
+// To build: gcc -Wall pipememcpy.c -o pipememcpy
+//
+// Moves buf_data_t from parent to child through a pipe:
+//
+//   --mode pipe      anonymous pipe, write() and read() (two copies)
+//   --mode fifo      named FIFO in /tmp, otherwise the same as pipe
+//   --mode vmsplice  anonymous pipe; the sender vmsplice()s its pages into
+//                    the pipe with SPLICE_F_GIFT instead of copying them,
+//                    so only the receiver's read() copies
+//
+// --pipe-size sets the pipe capacity with F_SETPIPE_SZ (unprivileged
+// callers are limited by /proc/sys/fs/pipe-max-size).
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <getopt.h>
+#include <signal.h>
+#include <errno.h>
+#include <sys/wait.h>
+#include <poll.h>
+#include "perfcount.h"
+#include "crc32c.h"
+#include "ipcstream.h"
+#include "ipcresult.h"
+#include "ipcpayload.h"
+#include "ipctrace.h"
+
+#define FIFO_PATH_FMT "/tmp/pipememcpy-%d"
+
+enum { MODE_PIPE = 0, MODE_FIFO, MODE_VMSPLICE };
+
+static const char *mode_names[] = { "pipe", "fifo", "vmsplice" };
+
+typedef struct {
+    struct timeval start;
+    struct timeval end;
+    uint64_t size;
+    uint32_t crc;       // CRC32C of data[], set by the sender with --verify
+    uint8_t data[];
+} buf_data_t;
+
+volatile sig_atomic_t sigusr1_received = 0;
+
+void handle_sigusr1(int sig) {
+    sigusr1_received = 1;
+}
+
+ssize_t full_write(int fd, const void *buf, size_t count) {
+    size_t written = 0;
+    while (written < count) {
+        ssize_t res = write(fd, (char *)buf + written, count - written);
+        if (res <= 0) return res;
+        written += res;
+    }
+    return written;
+}
+
+ssize_t full_read(int fd, void *buf, size_t count, ipc_trace_t *trace) {
+    size_t read_bytes = 0;
+    while (read_bytes < count) {
+        ssize_t res = read(fd, (char *)buf + read_bytes, count - read_bytes);
+        if (res <= 0) return res;
+        if (read_bytes == 0) ipc_trace_mark(trace, IPC_TRACE_CHILD, "first chunk");
+        read_bytes += res;
+    }
+    ipc_trace_mark(trace, IPC_TRACE_CHILD, "last chunk");
+    return read_bytes;
+}
+
+// Maps the buffer into the pipe instead of copying it.  Only whole,
+// page-aligned pages are gifted; the kernel copies any partial page.  The
+// pages stay referenced by the pipe until the reader consumes them, so the
+// buffer must not be modified or freed before then.
+ssize_t full_vmsplice(int fd, void *buf, size_t count) {
+    struct iovec iov = { buf, count };
+    while (iov.iov_len) {
+        ssize_t res = vmsplice(fd, &iov, 1, SPLICE_F_GIFT);
+        if (res <= 0) return res;
+        iov.iov_base = (char *)iov.iov_base + res;
+        iov.iov_len -= res;
+    }
+    return count;
+}
+
+int set_pipe_size(int fd, uint64_t pipe_size) {
+    if (pipe_size && fcntl(fd, F_SETPIPE_SZ, (int)pipe_size) < 0) {
+        perror("F_SETPIPE_SZ");
+        return -1;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t size = 0;
+    int perf = 0;
+    int trace_table = 0;
+    const char *trace_json = NULL;
+    int verify = 0;  // 1: checksum outside the timed region, 2: inside
+    int mode = MODE_PIPE;
+    uint64_t pipe_size = 0;  // 0 keeps the kernel default
+    int format = RESULT_TEXT;
+    const char *output = NULL;  // Append records here instead of stdout
+    int pattern = PATTERN_SEQ;
+    long src_align = -1, dst_align = -1;  // Payload offsets in a page; -1 leaves malloc() placement
+
+    static struct option long_options[] = {
+        {"size", required_argument, 0, 's'},
+        {"perf", no_argument, 0, 'P'},
+        {"trace", no_argument, 0, 'T'},
+        {"trace-json", required_argument, 0, 'J'},
+        {"verify", no_argument, 0, 'V'},
+        {"verify-timed", no_argument, 0, 'I'},
+        {"mode", required_argument, 0, 'm'},
+        {"pipe-size", required_argument, 0, 'p'},
+        {"pattern", required_argument, 0, 'D'},
+        {"align", required_argument, 0, 'A'},
+        {"format", required_argument, 0, 'f'},
+        {"output", required_argument, 0, 'o'},
+        {0, 0, 0, 0}
+    };
+
+    while (1) {
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "s:PTJ:VIm:p:D:A:f:o:", long_options, &option_index);
+        if (c == -1) break;
+
+        switch (c) {
+            case 's':
+                if (parse_size(optarg, &size) < 0) {
+                    fprintf(stderr, "Invalid size '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'P':
+                perf = 1;
+                break;
+            case 'T':
+                trace_table = 1;
+                break;
+            case 'J':
+                trace_json = optarg;
+                break;
+            case 'V':
+                verify = 1;
+                break;
+            case 'I':
+                verify = 2;
+                break;
+            case 'm':
+                if (strcmp(optarg, "pipe") == 0) mode = MODE_PIPE;
+                else if (strcmp(optarg, "fifo") == 0) mode = MODE_FIFO;
+                else if (strcmp(optarg, "vmsplice") == 0) mode = MODE_VMSPLICE;
+                else {
+                    fprintf(stderr, "Invalid mode '%s' (expected pipe, fifo or vmsplice).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'p':
+                if (parse_size(optarg, &pipe_size) < 0 || pipe_size == 0 || pipe_size > INT32_MAX) {
+                    fprintf(stderr, "Invalid pipe size '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'D':
+                pattern = payload_pattern_parse(optarg);
+                if (pattern < 0) {
+                    fprintf(stderr, "Invalid pattern '%s' (expected seq, random or zero).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'A':
+                if (payload_align_parse(optarg, &src_align, &dst_align) < 0) {
+                    fprintf(stderr, "Invalid alignment '%s' (SRC[,DST] bytes past a page boundary).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'f':
+                format = result_format_parse(optarg);
+                if (format < 0) {
+                    fprintf(stderr, "Invalid format '%s' (expected text, json or csv).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s --size NUMBER [--mode pipe|fifo|vmsplice] [--pipe-size BYTES] [--perf] [--trace] [--trace-json FILE] [--verify|--verify-timed] [--pattern seq|random|zero] [--align SRC[,DST]] [--format text|json|csv] [--output FILE]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    result_redirect_text(format, output);
+
+    if (size == 0) {
+        fprintf(stderr, "Invalid size specified.\n");
+        return EXIT_FAILURE;
+    }
+
+    size_t total_size = sizeof(buf_data_t) + size;
+
+    // The header starts a page unless --align says otherwise, so vmsplice
+    // can gift whole pages
+    payload_buf_t sb;
+    long src_offset = src_align >= 0 ? src_align : (long)sizeof(buf_data_t);
+    buf_data_t *src = payload_alloc(&sb, sizeof(buf_data_t), size, src_offset, 1);
+    if (!src) {
+        perror("mmap");
+        return EXIT_FAILURE;
+    }
+    src->size = size;
+    payload_fill(src->data, size, pattern);
+
+    int pipefd[2] = { -1, -1 };
+    char fifo_path[64];
+    if (mode == MODE_FIFO) {
+        snprintf(fifo_path, sizeof(fifo_path), FIFO_PATH_FMT, getpid());
+        unlink(fifo_path);
+        if (mkfifo(fifo_path, 0600) < 0) {
+            perror("mkfifo");
+            payload_free(&sb);
+            return EXIT_FAILURE;
+        }
+    } else {
+        if (pipe(pipefd) < 0) {
+            perror("pipe");
+            payload_free(&sb);
+            return EXIT_FAILURE;
+        }
+        if (set_pipe_size(pipefd[1], pipe_size) < 0) {
+            payload_free(&sb);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Shared between parent and child, so it must exist before fork
+    ipc_trace_t *trace = NULL;
+    if (trace_table || trace_json) trace = ipc_trace_create();
+
+    // Install before fork so the child's ready signal cannot arrive first
+    signal(SIGUSR1, handle_sigusr1);
+
+    pid_t child_pid = fork();
+    if (child_pid < 0) {
+        perror("fork");
+        payload_free(&sb);
+        if (mode == MODE_FIFO) unlink(fifo_path);
+        return EXIT_FAILURE;
+    }
+
+    if (child_pid == 0) {
+        // --- Child Process (Reader) ---
+        payload_buf_t db;
+        buf_data_t *dst = payload_alloc(&db, sizeof(buf_data_t), size, dst_align, 0);
+        if (!dst) {
+            perror("Child malloc");
+            exit(EXIT_FAILURE);
+        }
+
+        perf_counters_t pc;
+        if (perf) perf_counters_open(&pc);
+        if (perf) perf_counters_start(&pc);
+
+        int fd;
+        if (mode == MODE_FIFO) {
+            // Opening for read blocks until the parent opens for write
+            kill(getppid(), SIGUSR1);
+            fd = open(fifo_path, O_RDONLY);
+            if (fd < 0) {
+                perror("Child open");
+                payload_free(&db);
+                exit(EXIT_FAILURE);
+            }
+        } else {
+            close(pipefd[1]);
+            fd = pipefd[0];
+            kill(getppid(), SIGUSR1);
+        }
+
+        // Only when tracing: separate the wakeup from the first read
+        if (trace) {
+            struct pollfd pfd = { .fd = fd, .events = POLLIN };
+            poll(&pfd, 1, -1);
+            ipc_trace_mark(trace, IPC_TRACE_CHILD, "receiver wakeup");
+        }
+
+        if (full_read(fd, dst, total_size, trace) != total_size) {
+            fprintf(stderr, "Child: Failed to read complete buffer\n");
+            payload_free(&db);
+            close(fd);
+            exit(EXIT_FAILURE);
+        }
+
+        uint32_t crc = 0;
+        if (verify == 2) crc = crc32c(0, dst->data, size);
+
+        gettimeofday(&dst->end, NULL);
+        if (perf) perf_counters_stop(&pc);
+
+        if (verify == 1) crc = crc32c(0, dst->data, size);
+
+        long sec = dst->end.tv_sec - dst->start.tv_sec;
+        long usec = dst->end.tv_usec - dst->start.tv_usec;
+        if (usec < 0) {
+            sec--;
+            usec += 1000000;
+        }
+
+        double elapsed = sec + usec / 1e6;
+        double bps = elapsed > 0 ? (dst->size / elapsed) : 0;
+        double mbps = bps / 1e6;
+
+        printf("[Child] Elapsed Time: %.6f seconds\n", elapsed);
+        printf("[Child] Transferred:  %" PRIu64 " bytes\n", dst->size);
+        printf("[Child] Throughput:   %.2f bytes/sec (%.2f MB/sec)\n", bps, mbps);
+        result_print_peak("[Child] ", bps);
+        printf("[Child] Pipe Size:    %d bytes (%s)\n", fcntl(fd, F_GETPIPE_SZ), mode_names[mode]);
+        ipc_trace_mark(trace, IPC_TRACE_CHILD, "post-processing");
+        if (perf) {
+            perf_counters_print(&pc, "[Child] ");
+            perf_counters_close(&pc);
+        }
+
+        int ok = !verify || (crc32c_report_size("[Child] ", size, dst->size) == 0 &&
+                                crc32c_report("[Child] ", dst->crc, crc) == 0);
+
+        ipc_payload_t pl = { payload_pattern_names[pattern], src_offset, dst_align };
+        ipc_result_t result = { mode_names[mode], dst->size, elapsed, verify ? ok : -1, NULL, &pl };
+        result_emit(format, output, &result);
+
+        payload_free(&db);
+        close(fd);
+        exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+    } else {
+        // --- Parent Process (Writer) ---
+        while (!sigusr1_received) pause();
+
+        int fd;
+        if (mode == MODE_FIFO) {
+            fd = open(fifo_path, O_WRONLY);
+            if (fd < 0 || set_pipe_size(fd, pipe_size) < 0) {
+                if (fd < 0) perror("Parent open");
+                kill(child_pid, SIGTERM);
+                waitpid(child_pid, NULL, 0);
+                unlink(fifo_path);
+                payload_free(&sb);
+                return EXIT_FAILURE;
+            }
+        } else {
+            close(pipefd[0]);
+            fd = pipefd[1];
+        }
+
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "connected");
+
+        if (verify == 1) src->crc = crc32c(0, src->data, size);
+
+        perf_counters_t pc;
+        if (perf) perf_counters_open(&pc);
+
+        if (perf) perf_counters_start(&pc);
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "pre-send");
+        gettimeofday(&src->start, NULL);
+
+        if (verify == 2) src->crc = crc32c(0, src->data, size);
+
+        ssize_t sent;
+        if (mode == MODE_VMSPLICE) {
+            sent = full_vmsplice(fd, src, total_size);
+        } else {
+            sent = full_write(fd, src, total_size);
+        }
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "send return");
+        if (sent != total_size) {
+            perror(mode == MODE_VMSPLICE ? "Parent vmsplice" : "Parent write");
+        }
+        if (perf) perf_counters_stop(&pc);
+
+        close(fd);
+        int status;
+        wait(&status);  // The child has consumed every gifted page after this
+        if (perf) {
+            perf_counters_print(&pc, "[Parent] ");
+            perf_counters_close(&pc);
+        }
+
+        if (trace_table) ipc_trace_print_table(trace);
+        if (trace_json) ipc_trace_write_chrome(trace, trace_json);
+        ipc_trace_destroy(trace);
+        if (mode == MODE_FIFO) unlink(fifo_path);
+        payload_free(&sb);
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
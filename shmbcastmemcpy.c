@@ -0,0 +1,421 @@
+//
+// shmbcastmemcpy.c
+//
+// For questions/support: norman.mcentire@gmail.com
+//
+// To build: gcc -Wall -O2 shmbcastmemcpy.c -o shmbcastmemcpy -lrt
+//
+// One writer broadcasting frames to many readers through a ring in shared
+// memory.  The writer never waits for anyone: it publishes frame f into
+// slot f % --slots under a per-slot sequence lock (odd while it writes,
+// 2f+2 once frame f is complete) and moves on.  Each reader is a separate
+// process that follows the ring at its own pace, copying every frame out
+// and re-checking the sequence afterwards:
+//
+//   sequence still 2f+2       the copy is frame f, intact
+//   sequence beyond 2f+2      the writer lapped the reader, which counts
+//                             the frames it missed as overruns and skips
+//                             ahead to half a ring behind the writer
+//
+// Resuming at the oldest frame still in the ring would put the reader on
+// the slot the writer fills next, so a reader only slightly slower than
+// the writer would be lapped again on nearly every frame; half a ring
+// gives it room to catch up.
+//
+// For each reader count in --readers LIST, --count frames are published
+// (as fast as possible, or at --rate frames/sec) and the writer's
+// throughput is reported with each reader's latency from publication to
+// the end of its copy, frames received and overruns.  Latencies are taken
+// from the scheduled publication time at a fixed --rate (see ipclat.h).
+// Frame f is the source pattern stamped with f, so with --verify each
+// reader keeps its copies and checks them against that after the step;
+// neither side computes a CRC while it runs.
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <sched.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include "crc32c.h"
+#include "ipcstream.h"
+#include "ipcresult.h"
+#include "ipclat.h"
+
+#define SHM_NAME "/my_shared_ring"
+#define MAX_STEPS 64
+#define MAX_READERS 256
+#define LINE 64
+
+// Slot header on its own cache line, the payload after it
+typedef struct {
+    uint64_t seq;          // 2f+1 while frame f is written, 2f+2 once complete
+    uint64_t sent_ns;      // CLOCK_MONOTONIC publication time
+    uint8_t pad[LINE - 16];
+} slot_hdr_t;
+
+typedef struct {
+    uint64_t head;         // Frames published
+    uint32_t ready;        // Readers attached and waiting for frame 0
+    uint32_t failed;       // Readers that could not attach
+    uint8_t pad[LINE - 16];
+} ring_t;
+
+// Stored once by a reader as it exits, read by the writer after that.  A
+// line each, so the latency arrays that follow start on a line too.
+typedef struct {
+    uint64_t received;
+    uint64_t overruns;     // Frames lost to the writer lapping the reader
+    uint64_t mismatches;
+    uint64_t last;         // Time of the last completed copy
+    uint8_t pad[LINE - 32];
+} reader_stats_t;
+
+static inline slot_hdr_t *ring_slot(ring_t *ring, size_t stride, uint64_t i) {
+    return (slot_hdr_t *)((uint8_t *)(ring + 1) + i * stride);
+}
+
+void spin_wait(unsigned *spins) {
+    // Give the CPU away now and then, or a reader sharing it with the
+    // writer spins its whole time slice
+    if (++*spins % 1024 == 0) sched_yield();
+}
+
+// The payload of frame f: src with f stamped over its first bytes
+static inline void frame_pattern(uint8_t *dst, const uint8_t *src, uint64_t size, uint64_t f) {
+    memcpy(dst, src, size);
+    memcpy(dst, &f, size < 8 ? size : 8);   // Every frame differs, so a torn copy shows
+}
+
+int reader(ring_t *ring, size_t stride, uint64_t slots, const uint8_t *src, uint64_t size,
+           uint64_t count, int verify, reader_stats_t *out, double *lat) {
+    // Counters stay local until the end: readers share no lines while they run
+    reader_stats_t stats = { 0 }, *st = &stats;
+    // With --verify every copy is kept, with the frame it came from
+    uint8_t *dst = malloc((verify ? count : 1) * size);
+    uint64_t *frames = verify ? malloc(count * sizeof(uint64_t)) : NULL;
+    uint8_t *ref = verify ? malloc(size) : NULL;
+    if (!dst || (verify && (!frames || !ref))) {
+        perror(verify ? "Reader malloc (--verify keeps a whole step)" : "Reader malloc");
+        free(dst);
+        free(frames);
+        free(ref);
+        __atomic_add_fetch(&ring->failed, 1, __ATOMIC_RELEASE);
+        return -1;
+    }
+    memset(dst, 0, (verify ? count : 1) * size);
+    __atomic_add_fetch(&ring->ready, 1, __ATOMIC_RELEASE);
+
+    unsigned spins = 0;
+    for (uint64_t f = 0; f < count;) {
+        slot_hdr_t *slot = ring_slot(ring, stride, f % slots);
+        uint64_t want = 2 * f + 2;
+        uint64_t s1 = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (s1 < want) {
+            spin_wait(&spins);   // Not published yet
+            continue;
+        }
+
+        int lapped = s1 > want;
+        uint64_t sent = 0;
+        uint8_t *copy = dst + (verify ? st->received * size : 0);
+        if (!lapped) {
+            sent = slot->sent_ns;
+            memcpy(copy, slot + 1, size);
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            lapped = __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != s1;
+        }
+        if (lapped) {
+            // Resume half a ring behind the writer (see the top of the file)
+            uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+            uint64_t next = head > slots / 2 ? head - slots / 2 : 0;
+            if (next <= f) next = f + 1;
+            if (next > count) next = count;
+            st->overruns += next - f;
+            f = next;
+            continue;
+        }
+
+        uint64_t now = lat_now_ns();
+        if (verify) frames[st->received] = f;
+        lat[st->received++] = (double)(int64_t)(now - sent) / 1e9;
+        st->last = now;
+        f++;
+    }
+
+    // After the step, against what the writer published as each frame
+    for (uint64_t i = 0; verify && i < st->received; i++) {
+        frame_pattern(ref, src, size, frames[i]);
+        if (crc32c(0, dst + i * size, size) != crc32c(0, ref, size)) st->mismatches++;
+    }
+
+    *out = stats;
+    free(ref);
+    free(frames);
+    free(dst);
+    return 0;
+}
+
+// Publishes count frames; returns the time the last one completed
+uint64_t writer(ring_t *ring, size_t stride, uint64_t slots, const uint8_t *src, uint64_t size,
+                uint64_t count, double rate, uint64_t start) {
+    for (uint64_t f = 0; f < count; f++) {
+        uint64_t when;
+        if (rate > 0) {
+            when = start + (uint64_t)(f * (1e9 / rate));
+            lat_wait_until(when);
+        } else {
+            when = lat_now_ns();
+        }
+
+        slot_hdr_t *slot = ring_slot(ring, stride, f % slots);
+        uint8_t *data = (uint8_t *)(slot + 1);
+        __atomic_store_n(&slot->seq, 2 * f + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+        slot->sent_ns = when;
+        frame_pattern(data, src, size, f);
+        __atomic_store_n(&slot->seq, 2 * f + 2, __ATOMIC_RELEASE);
+        __atomic_store_n(&ring->head, f + 1, __ATOMIC_RELEASE);
+    }
+    return lat_now_ns();
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t size = 0;
+    double steps[MAX_STEPS];
+    int nsteps = lat_parse_steps("1:8", steps, MAX_STEPS);
+    uint64_t slots = 64;
+    uint64_t count = 100000;  // Frames per step
+    double rate = 0;          // Frames/sec; 0 publishes as fast as possible
+    int verify = 0;
+    int format = RESULT_TEXT;
+    const char *output = NULL;  // Append records here instead of stdout
+
+    static struct option long_options[] = {
+        {"size", required_argument, 0, 's'},
+        {"readers", required_argument, 0, 'n'},
+        {"slots", required_argument, 0, 'S'},
+        {"count", required_argument, 0, 'c'},
+        {"rate", required_argument, 0, 'r'},
+        {"verify", no_argument, 0, 'V'},
+        {"format", required_argument, 0, 'f'},
+        {"output", required_argument, 0, 'o'},
+        {0, 0, 0, 0}
+    };
+
+    while (1) {
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "s:n:S:c:r:Vf:o:", long_options, &option_index);
+        if (c == -1) break;
+
+        switch (c) {
+            case 's':
+                if (parse_size(optarg, &size) < 0) {
+                    fprintf(stderr, "Invalid size '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'n':
+                nsteps = lat_parse_steps(optarg, steps, MAX_STEPS);
+                for (int i = 0; i < nsteps; i++) {
+                    if (steps[i] < 1 || steps[i] > MAX_READERS || steps[i] != (int)steps[i]) nsteps = -1;
+                }
+                if (nsteps <= 0) {
+                    fprintf(stderr, "Invalid reader counts '%s' (1 to %d, e.g. 1,2,4 or 1:8).\n", optarg, MAX_READERS);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'S':
+                if (parse_size(optarg, &slots) < 0 || slots < 2) {
+                    fprintf(stderr, "Invalid slot count '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'c':
+                if (parse_size(optarg, &count) < 0 || count == 0) {
+                    fprintf(stderr, "Invalid count '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'r':
+                rate = strtod(optarg, NULL);
+                if (rate < 0) {
+                    fprintf(stderr, "Invalid rate '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'V':
+                verify = 1;
+                break;
+            case 'f':
+                format = result_format_parse(optarg);
+                if (format < 0) {
+                    fprintf(stderr, "Invalid format '%s' (expected text, json or csv).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s --size NUMBER [--readers LIST] [--slots N] [--count N] [--rate FRAMES/SEC] [--verify] [--format text|json|csv] [--output FILE]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    result_redirect_text(format, output);
+
+    if (size == 0) {
+        fprintf(stderr, "Invalid size specified.\n");
+        return EXIT_FAILURE;
+    }
+
+    int max_readers = 0;
+    for (int i = 0; i < nsteps; i++) {
+        if (steps[i] > max_readers) max_readers = (int)steps[i];
+    }
+
+    uint8_t *src = malloc(size);
+    if (!src) {
+        perror("malloc");
+        return EXIT_FAILURE;
+    }
+    for (uint64_t i = 0; i < size; i++) {
+        src[i] = (uint8_t)i;
+    }
+
+    // The ring: a header line, then slots of a header line and the payload
+    // rounded up to whole lines
+    size_t stride = sizeof(slot_hdr_t) + (size + LINE - 1) / LINE * LINE;
+    size_t ring_size = sizeof(ring_t) + slots * stride;
+    int shm_fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0666);
+    if (shm_fd < 0) {
+        perror("shm_open");
+        free(src);
+        return EXIT_FAILURE;
+    }
+    if (ftruncate(shm_fd, ring_size) < 0) {
+        perror("ftruncate");
+        shm_unlink(SHM_NAME);
+        free(src);
+        return EXIT_FAILURE;
+    }
+    ring_t *ring = mmap(NULL, ring_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+    close(shm_fd);
+
+    // Results come back through a shared anonymous mapping, not the ring
+    size_t stats_size = max_readers * (sizeof(reader_stats_t) + count * sizeof(double));
+    uint8_t *stats = mmap(NULL, stats_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    double *all = malloc(max_readers * count * sizeof(double));
+    if (ring == MAP_FAILED || stats == MAP_FAILED || !all) {
+        perror("mmap");
+        shm_unlink(SHM_NAME);
+        free(src);
+        return EXIT_FAILURE;
+    }
+    reader_stats_t *st = (reader_stats_t *)stats;
+    double *lat = (double *)(st + max_readers);
+
+    printf("[Writer] Ring:         %" PRIu64 " slots of %zu bytes, %" PRIu64 " frames of %" PRIu64 " bytes per step",
+           slots, stride, count, size);
+    if (rate > 0) printf(" at %.0f frames/sec", rate);
+    printf("\n");
+
+    int ok = 1;
+    uint64_t mismatches = 0;
+    for (int s = 0; s < nsteps && ok; s++) {
+        int n = (int)steps[s];
+        memset(ring, 0, ring_size);
+        memset(stats, 0, n * sizeof(reader_stats_t));
+
+        fflush(stdout);   // Or the readers inherit the buffered output
+        pid_t pids[MAX_READERS];
+        int forked = 0;
+        for (; forked < n; forked++) {
+            pids[forked] = fork();
+            if (pids[forked] < 0) {
+                perror("fork");
+                ok = 0;
+                break;
+            }
+            if (pids[forked] == 0) {
+                // --- Reader Process ---
+                int rc = reader(ring, stride, slots, src, size, count, verify, &st[forked], lat + forked * count);
+                exit(rc == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+            }
+        }
+
+        // Start only once every reader waits for frame 0
+        unsigned spins = 0;
+        while (ok && __atomic_load_n(&ring->ready, __ATOMIC_ACQUIRE) < (uint32_t)n) {
+            if (__atomic_load_n(&ring->failed, __ATOMIC_ACQUIRE)) ok = 0;
+            spin_wait(&spins);
+        }
+
+        // Without a writer the readers would wait for frame 0 forever
+        for (int i = 0; !ok && i < forked; i++) kill(pids[i], SIGTERM);
+
+        uint64_t start = lat_now_ns(), end = start;
+        if (ok) end = writer(ring, stride, slots, src, size, count, rate, start);
+
+        for (int i = 0; i < forked; i++) {
+            int status;
+            waitpid(pids[i], &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) ok = 0;
+        }
+        if (!ok) break;
+
+        double span = (end - start) / 1e9;
+        printf("[Writer] Readers:      %d\n", n);
+        printf("[Writer] Throughput:   %.1f frames/sec (%.2f MB/sec)\n",
+               span > 0 ? count / span : 0, span > 0 ? count * size / span / 1e6 : 0);
+        result_print_peak("[Writer] ", span > 0 ? count * size / span : 0);
+        lat_print_header("[Reader] ", "Reader");
+
+        uint64_t pooled = 0, bad = 0;
+        for (int i = 0; i < n; i++) {
+            double *v = lat + i * count;
+            uint64_t got = st[i].received;
+            memcpy(all + pooled, v, got * sizeof(double));
+            pooled += got;
+
+            ipc_latency_t l = { rate, 0 };
+            lat_summarize(v, got, &l);
+            double rspan = st[i].last > start ? (st[i].last - start) / 1e9 : 0;
+            lat_print("[Reader] ", i, rspan > 0 ? got / rspan : 0, &l);
+            printf("[Reader]              %" PRIu64 " received, %" PRIu64 " overrun (%.2f%%)\n",
+                   got, st[i].overruns, 100.0 * st[i].overruns / count);
+            bad += st[i].mismatches;
+        }
+        mismatches += bad;
+
+        // elapsed is the writer's cost per frame; the latency is over all readers
+        ipc_latency_t l = { rate, 0 };
+        lat_summarize(all, pooled, &l);
+        char label[64];
+        snprintf(label, sizeof(label), "shm-bcast-%d", n);
+        ipc_result_t result = { label, size, span / count, verify ? bad == 0 : -1, &l };
+        result_emit(format, output, &result);
+    }
+
+    if (verify && ok) {
+        if (mismatches) printf("[Reader] Verified:     FAILED (%" PRIu64 " frames with a bad crc32c)\n", mismatches);
+        else printf("[Reader] Verified:     OK (crc32c per frame after the step, %s)\n", crc32c_impl());
+        if (mismatches) ok = 0;
+    }
+
+    munmap(ring, ring_size);
+    munmap(stats, stats_size);
+    shm_unlink(SHM_NAME);
+    free(all);
+    free(src);
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
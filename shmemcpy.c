@@ -19,13 +19,20 @@
 #include <sys/stat.h>
 #include <sys/wait.h>
 #include <errno.h>
+#include "perfcount.h"
+#include "crc32c.h"
+#include "ipcstream.h"
+#include "ipcresult.h"
+#include "ipcpayload.h"
+#include "ipctrace.h"
 
 #define SHM_NAME "/my_shared_buf"
 
 typedef struct {
     struct timeval start;
     struct timeval end;
-    uint32_t size;
+    uint64_t size;
+    uint32_t crc;       // CRC32C of data[], set by the sender with --verify
     uint8_t data[];
 } buf_data_t;
 
@@ -41,29 +48,89 @@ void handle_sigio(int sig) {
 }
 
 int main(int argc, char *argv[]) {
-    int size = 0;
+    uint64_t size = 0;
+    int perf = 0;
+    int trace_table = 0;
+    const char *trace_json = NULL;
+    int verify = 0;  // 1: checksum outside the timed region, 2: inside
+    int format = RESULT_TEXT;
+    const char *output = NULL;  // Append records here instead of stdout
+    int pattern = PATTERN_SEQ;
+    long src_align = -1, dst_align = -1;  // Payload offsets in a page; -1 leaves malloc() placement
 
     static struct option long_options[] = {
         {"size", required_argument, 0, 's'},
+        {"perf", no_argument, 0, 'P'},
+        {"trace", no_argument, 0, 'T'},
+        {"trace-json", required_argument, 0, 'J'},
+        {"verify", no_argument, 0, 'V'},
+        {"verify-timed", no_argument, 0, 'I'},
+        {"pattern", required_argument, 0, 'D'},
+        {"align", required_argument, 0, 'A'},
+        {"format", required_argument, 0, 'f'},
+        {"output", required_argument, 0, 'o'},
         {0, 0, 0, 0}
     };
 
     while (1) {
         int option_index = 0;
-        int c = getopt_long(argc, argv, "s:", long_options, &option_index);
+        int c = getopt_long(argc, argv, "s:PTJ:VID:A:f:o:", long_options, &option_index);
         if (c == -1) break;
 
         switch (c) {
             case 's':
-                size = atoi(optarg);
+                if (parse_size(optarg, &size) < 0) {
+                    fprintf(stderr, "Invalid size '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'P':
+                perf = 1;
+                break;
+            case 'T':
+                trace_table = 1;
+                break;
+            case 'J':
+                trace_json = optarg;
+                break;
+            case 'V':
+                verify = 1;
+                break;
+            case 'I':
+                verify = 2;
+                break;
+            case 'D':
+                pattern = payload_pattern_parse(optarg);
+                if (pattern < 0) {
+                    fprintf(stderr, "Invalid pattern '%s' (expected seq, random or zero).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'A':
+                if (payload_align_parse(optarg, &src_align, &dst_align) < 0) {
+                    fprintf(stderr, "Invalid alignment '%s' (SRC[,DST] bytes past a page boundary).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'f':
+                format = result_format_parse(optarg);
+                if (format < 0) {
+                    fprintf(stderr, "Invalid format '%s' (expected text, json or csv).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'o':
+                output = optarg;
                 break;
             default:
-                fprintf(stderr, "Usage: %s --size NUMBER\n", argv[0]);
+                fprintf(stderr, "Usage: %s --size NUMBER [--perf] [--trace] [--trace-json FILE] [--verify|--verify-timed] [--pattern seq|random|zero] [--align SRC[,DST]] [--format text|json|csv] [--output FILE]\n", argv[0]);
                 return EXIT_FAILURE;
         }
     }
 
-    if (size <= 0) {
+    result_redirect_text(format, output);
+
+    if (size == 0) {
         fprintf(stderr, "Invalid size specified.\n");
         return EXIT_FAILURE;
     }
@@ -71,36 +138,47 @@ int main(int argc, char *argv[]) {
     size_t total_size = sizeof(buf_data_t) + size;
 
     // Allocate src in heap
-    buf_data_t *src = malloc(total_size);
+    payload_buf_t sb;
+    buf_data_t *src = payload_alloc(&sb, sizeof(buf_data_t), size, src_align, pattern == PATTERN_ZERO);
     if (!src) {
         perror("malloc");
         return EXIT_FAILURE;
     }
     src->size = size;
-    for (int i = 0; i < size; i++) {
-        src->data[i] = (uint8_t)i;
-    }
+    payload_fill(src->data, size, pattern);
+
+    // dst sits at the start of the segment, or with --align so that its
+    // payload lands dst_align bytes into the segment's second page
+    size_t shm_off = dst_align >= 0 ? sysconf(_SC_PAGESIZE) + dst_align - sizeof(buf_data_t) : 0;
+    size_t shm_len = shm_off + total_size;
 
     // Create and set up shared memory
     int shm_fd = shm_open(SHM_NAME, O_CREAT | O_RDWR, 0666);
     if (shm_fd < 0) {
         perror("shm_open");
-        free(src);
+        payload_free(&sb);
         return EXIT_FAILURE;
     }
 
-    if (ftruncate(shm_fd, total_size) < 0) {
+    if (ftruncate(shm_fd, shm_len) < 0) {
         perror("ftruncate");
         shm_unlink(SHM_NAME);
-        free(src);
+        payload_free(&sb);
         return EXIT_FAILURE;
     }
 
+    // Shared between parent and child, so it must exist before fork
+    ipc_trace_t *trace = NULL;
+    if (trace_table || trace_json) trace = ipc_trace_create();
+
+    // Install before fork so the child's ready signal cannot arrive first
+    signal(SIGUSR1, handle_sigusr1);
+
     pid_t child_pid = fork();
     if (child_pid < 0) {
         perror("fork");
         shm_unlink(SHM_NAME);
-        free(src);
+        payload_free(&sb);
         return EXIT_FAILURE;
     }
 
@@ -115,20 +193,32 @@ int main(int argc, char *argv[]) {
             exit(EXIT_FAILURE);
         }
 
-        buf_data_t *dst = mmap(NULL, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
-        if (dst == MAP_FAILED) {
+        uint8_t *map = mmap(NULL, shm_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (map == MAP_FAILED) {
             perror("child mmap");
             exit(EXIT_FAILURE);
         }
+        buf_data_t *dst = (buf_data_t *)(map + shm_off);
+
+        perf_counters_t pc;
+        if (perf) perf_counters_open(&pc);
+        if (perf) perf_counters_start(&pc);
 
         // Notify parent process that we're ready
         kill(getppid(), SIGUSR1);
 
         // Wait for SIGIO from parent
         while (!sigio_received) pause();
+        ipc_trace_mark(trace, IPC_TRACE_CHILD, "receiver wakeup");
+
+        uint32_t crc = 0;
+        if (verify == 2) crc = crc32c(0, dst->data, size);
 
         // Record end time
         gettimeofday(&dst->end, NULL);
+        if (perf) perf_counters_stop(&pc);
+
+        if (verify == 1) crc = crc32c(0, dst->data, size);
 
         // Compute and display metrics
         long sec = dst->end.tv_sec - dst->start.tv_sec;
@@ -145,39 +235,74 @@ int main(int argc, char *argv[]) {
         printf("[Child] Elapsed Time: %.6f seconds\n", elapsed);
         printf("[Child] Transferred:  %zu bytes\n", bytes);
         printf("[Child] Throughput:   %.2f bytes/sec (%.2f MB/sec)\n", bps, mbps);
+        result_print_peak("[Child] ", bps);
+        ipc_trace_mark(trace, IPC_TRACE_CHILD, "post-processing");
+        if (perf) {
+            perf_counters_print(&pc, "[Child] ");
+            perf_counters_close(&pc);
+        }
+
+        int ok = !verify || (crc32c_report_size("[Child] ", size, dst->size) == 0 &&
+                                crc32c_report("[Child] ", dst->crc, crc) == 0);
+
+        long src_offset = payload_offset(src_align, pattern == PATTERN_ZERO);
+        ipc_payload_t pl = { payload_pattern_names[pattern], src_offset, dst_align };
+        ipc_result_t result = { "shm", dst->size, elapsed, verify ? ok : -1, NULL, &pl };
+        result_emit(format, output, &result);
 
-        munmap(dst, total_size);
+        munmap(map, shm_len);
         close(fd);
-        exit(EXIT_SUCCESS);
+        exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
     } else {
         // --- Parent Process ---
-        signal(SIGUSR1, handle_sigusr1);
-
         // Wait for SIGUSR1 from child
         while (!sigusr1_received) pause();
 
         // Map the shared memory
-        buf_data_t *dst = mmap(NULL, total_size, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-        if (dst == MAP_FAILED) {
+        uint8_t *map = mmap(NULL, shm_len, PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
+        buf_data_t *dst = (buf_data_t *)(map + shm_off);
+        if (map == MAP_FAILED) {
             perror("parent mmap");
             shm_unlink(SHM_NAME);
-            free(src);
+            payload_free(&sb);
             return EXIT_FAILURE;
         }
 
+        perf_counters_t pc;
+        if (perf) perf_counters_open(&pc);
+
+        if (verify == 1) src->crc = crc32c(0, src->data, size);
+
         // Record start time and copy to shared memory
+        if (perf) perf_counters_start(&pc);
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "pre-send");
         gettimeofday(&src->start, NULL);
+        if (verify == 2) src->crc = crc32c(0, src->data, size);
         memcpy(dst, src, total_size);
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "copy done");
 
         // Notify child
         kill(child_pid, SIGIO);
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "send return");
+        if (perf) perf_counters_stop(&pc);
 
         // Cleanup
-        wait(NULL);
-        munmap(dst, total_size);
+        int status;
+        wait(&status);
+        if (perf) {
+            perf_counters_print(&pc, "[Parent] ");
+            perf_counters_close(&pc);
+        }
+
+        if (trace_table) ipc_trace_print_table(trace);
+        if (trace_json) ipc_trace_write_chrome(trace, trace_json);
+        ipc_trace_destroy(trace);
+        munmap(map, shm_len);
         close(shm_fd);
         shm_unlink(SHM_NAME);
-        free(src);
+        payload_free(&sb);
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) return EXIT_FAILURE;
     }
 
     return EXIT_SUCCESS;
@@ -0,0 +1,299 @@
+//
+// streambw.c
+//
+// For questions/support: norman.mcentire@gmail.com
+//
+// To build: gcc -Wall -O2 streambw.c -o streambw -lpthread -lm
+//
+// Memory-bandwidth baseline after McCalpin's STREAM: the copy, scale, add
+// and triad kernels over three arrays of doubles, first on one core and
+// then with one thread per CPU it may run on (--threads to change that,
+// taskset to restrict it).  Each kernel runs --reps times and the best
+// time counts, the first repetition excepted.  Rates use the STREAM
+// convention of bytes read plus bytes written, so copy moves 2 x --size
+// bytes per pass.
+//
+// The last line is the peak copy bandwidth in bytes *copied* per second
+// (half the STREAM copy rate), which is what the other tools' throughput
+// counts.  Export it as IPC_PEAK_BPS and every tool also reports its
+// throughput as a percentage of it; ipcsuite.sh does this before its runs.
+//
+// Each array defaults to 4x the last-level cache, 64 MB to 1 GB, so no
+// kernel runs from cache.
+//
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "ipcstream.h"
+#include "ipcresult.h"
+
+#define MAX_THREADS 1024
+#define SCALAR 3.0
+
+enum { K_COPY = 0, K_SCALE, K_ADD, K_TRIAD, K_COUNT };
+
+static const char *kernel_names[] = { "Copy", "Scale", "Add", "Triad" };
+static const int kernel_arrays[] = { 2, 2, 3, 3 };  // Arrays touched per pass
+
+typedef struct {
+    pthread_t tid;
+    int cpu;               // -1 when not pinned
+    size_t lo, hi;         // Element range of this thread
+} worker_t;
+
+static double *a, *b, *c;
+static pthread_barrier_t barrier;
+static volatile int kernel;   // Set by the main thread between barriers
+
+void run_kernel(int k, size_t lo, size_t hi) {
+    switch (k) {
+        case K_COPY:
+            for (size_t i = lo; i < hi; i++) c[i] = a[i];
+            break;
+        case K_SCALE:
+            for (size_t i = lo; i < hi; i++) b[i] = SCALAR * c[i];
+            break;
+        case K_ADD:
+            for (size_t i = lo; i < hi; i++) c[i] = a[i] + b[i];
+            break;
+        case K_TRIAD:
+            for (size_t i = lo; i < hi; i++) a[i] = b[i] + SCALAR * c[i];
+            break;
+    }
+}
+
+void *worker(void *arg) {
+    worker_t *w = arg;
+
+    // First touch from the thread that uses the pages keeps them on its node
+    for (size_t i = w->lo; i < w->hi; i++) {
+        a[i] = 1.0;
+        b[i] = 2.0;
+        c[i] = 0.0;
+    }
+    pthread_barrier_wait(&barrier);
+
+    while (1) {
+        pthread_barrier_wait(&barrier);   // Start
+        int k = kernel;
+        if (k < 0) return NULL;
+        run_kernel(k, w->lo, w->hi);
+        pthread_barrier_wait(&barrier);   // Done
+    }
+}
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Checks the arrays against the values the kernels should have produced
+int validate(size_t n, int reps) {
+    double aj = 1.0, bj = 2.0, cj = 0.0;
+    for (int r = 0; r < reps; r++) {
+        cj = aj;
+        bj = SCALAR * cj;
+        cj = aj + bj;
+        aj = bj + SCALAR * cj;
+    }
+    for (size_t i = 0; i < n; i++) {
+        if (fabs(a[i] - aj) > 1e-13 * aj || fabs(b[i] - bj) > 1e-13 * bj || fabs(c[i] - cj) > 1e-13 * cj) {
+            fprintf(stderr, "Validation failed at element %zu\n", i);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// One pass of the four kernels reps times on nthreads threads; returns the
+// best copy rate in bytes copied per second, or a negative value on error
+double run(size_t n, int nthreads, const int *cpus, int reps, int verify, int format, const char *output) {
+    static worker_t workers[MAX_THREADS];
+    pthread_barrier_init(&barrier, NULL, nthreads + 1);
+
+    for (int t = 0; t < nthreads; t++) {
+        worker_t *w = &workers[t];
+        w->cpu = cpus ? cpus[t] : -1;
+        w->lo = n * t / nthreads;
+        w->hi = n * (t + 1) / nthreads;
+
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        if (w->cpu >= 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(w->cpu, &set);
+            pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+        }
+        int rc = pthread_create(&w->tid, &attr, worker, w);
+        pthread_attr_destroy(&attr);
+        if (rc != 0) {
+            fprintf(stderr, "pthread_create: %s\n", strerror(rc));
+            exit(EXIT_FAILURE);
+        }
+    }
+    pthread_barrier_wait(&barrier);   // Arrays initialised
+
+    double times[K_COUNT][reps];
+    for (int r = 0; r < reps; r++) {
+        for (int k = 0; k < K_COUNT; k++) {
+            kernel = k;
+            double t0 = now_sec();
+            pthread_barrier_wait(&barrier);
+            pthread_barrier_wait(&barrier);
+            times[k][r] = now_sec() - t0;
+        }
+    }
+    kernel = -1;
+    pthread_barrier_wait(&barrier);
+    for (int t = 0; t < nthreads; t++) pthread_join(workers[t].tid, NULL);
+    pthread_barrier_destroy(&barrier);
+
+    int ok = !verify || validate(n, reps) == 0;
+
+    printf("[Stream] %-8s %7s %12s %12s %12s %12s\n", "Function", "Threads", "Best MB/s", "Avg time", "Min time", "Max time");
+    double copy_bps = 0;
+    for (int k = 0; k < K_COUNT; k++) {
+        double min = times[k][1], max = times[k][1], sum = 0;
+        for (int r = 1; r < reps; r++) {
+            if (times[k][r] < min) min = times[k][r];
+            if (times[k][r] > max) max = times[k][r];
+            sum += times[k][r];
+        }
+        uint64_t bytes = (uint64_t)kernel_arrays[k] * n * sizeof(double);
+        printf("[Stream] %-8s %7d %12.1f %12.6f %12.6f %12.6f\n", kernel_names[k], nthreads,
+               bytes / min / 1e6, sum / (reps - 1), min, max);
+        if (k == K_COPY) copy_bps = n * sizeof(double) / min;
+
+        char label[64];
+        snprintf(label, sizeof(label), "stream-%s-%d", kernel_names[k], nthreads);
+        for (char *p = label; *p; p++) *p = (char)(*p >= 'A' && *p <= 'Z' ? *p - 'A' + 'a' : *p);
+        ipc_result_t result = { label, bytes, min, verify ? ok : -1 };
+        result_emit(format, output, &result);
+    }
+    return ok ? copy_bps : -1;
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t size = 0;     // Bytes per array
+    int reps = 10;
+    int nthreads = 0;      // All-core pass; 0 for one per CPU we may run on
+    int verify = 0;
+    int format = RESULT_TEXT;
+    const char *output = NULL;  // Append records here instead of stdout
+
+    static struct option long_options[] = {
+        {"size", required_argument, 0, 's'},
+        {"reps", required_argument, 0, 'r'},
+        {"threads", required_argument, 0, 't'},
+        {"verify", no_argument, 0, 'V'},
+        {"format", required_argument, 0, 'f'},
+        {"output", required_argument, 0, 'o'},
+        {0, 0, 0, 0}
+    };
+
+    while (1) {
+        int option_index = 0;
+        int c = getopt_long(argc, argv, "s:r:t:Vf:o:", long_options, &option_index);
+        if (c == -1) break;
+
+        switch (c) {
+            case 's':
+                if (parse_size(optarg, &size) < 0 || size < 1024 * 1024) {
+                    fprintf(stderr, "Invalid size '%s' (at least 1M per array).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'r':
+                reps = atoi(optarg);
+                if (reps < 2) {
+                    fprintf(stderr, "Invalid repetitions '%s' (at least 2).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 't':
+                nthreads = atoi(optarg);
+                if (nthreads < 0 || nthreads > MAX_THREADS) {
+                    fprintf(stderr, "Invalid thread count '%s' (1 to %d, 0 for one per CPU).\n", optarg, MAX_THREADS);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'V':
+                verify = 1;
+                break;
+            case 'f':
+                format = result_format_parse(optarg);
+                if (format < 0) {
+                    fprintf(stderr, "Invalid format '%s' (expected text, json or csv).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'o':
+                output = optarg;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [--size BYTES] [--reps N] [--threads N] [--verify] [--format text|json|csv] [--output FILE]\n", argv[0]);
+                return EXIT_FAILURE;
+        }
+    }
+
+    result_redirect_text(format, output);
+
+    if (!size) {
+        size = 4 * (uint64_t)llc_size();
+        if (size < (64 << 20)) size = 64 << 20;
+        if (size > (1 << 30)) size = 1 << 30;
+    }
+    size_t n = size / sizeof(double);
+
+    // One thread per CPU in our affinity mask, so taskset limits the pass
+    cpu_set_t mask;
+    int cpus[MAX_THREADS], ncpus = 0;
+    if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE && ncpus < MAX_THREADS; cpu++) {
+            if (CPU_ISSET(cpu, &mask)) cpus[ncpus++] = cpu;
+        }
+    }
+    if (ncpus == 0) cpus[ncpus++] = 0;
+    if (nthreads == 0) nthreads = ncpus;
+
+    a = aligned_alloc(64, n * sizeof(double));
+    b = aligned_alloc(64, n * sizeof(double));
+    c = aligned_alloc(64, n * sizeof(double));
+    if (!a || !b || !c) {
+        perror("aligned_alloc");
+        return EXIT_FAILURE;
+    }
+
+    printf("[Stream] Array size:   %zu bytes x 3, best of %d repetitions\n", n * sizeof(double), reps - 1);
+    double single = run(n, 1, cpus, reps, verify, format, output);
+    double all = single;
+    if (single >= 0 && nthreads > 1) {
+        // Threads beyond the CPUs we may use run unpinned
+        all = run(n, nthreads, nthreads <= ncpus ? cpus : NULL, reps, verify, format, output);
+    }
+    if (single < 0 || all < 0) {
+        printf("[Stream] Validated:    FAILED\n");
+        return EXIT_FAILURE;
+    }
+    if (verify) printf("[Stream] Validated:    OK\n");
+
+    double peak = all > single ? all : single;
+    printf("[Stream] Single core:  %.0f bytes/sec copied (%.2f MB/sec)\n", single, single / 1e6);
+    printf("[Stream] Peak copy:    %.0f bytes/sec copied (%.2f MB/sec, %d threads)\n", peak, peak / 1e6,
+           all > single ? nthreads : 1);
+
+    free(a);
+    free(b);
+    free(c);
+    return EXIT_SUCCESS;
+}
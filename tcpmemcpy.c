@@ -5,10 +5,36 @@
 //
 // To build: gcc -Wall tcpmemcpy.c -o tcpmemcpy
 //
+// --rate LIST switches to an open-loop run: for each offered rate the
+// parent sends --count messages of --size bytes on a fixed schedule,
+// without waiting for the receiver, and the child reports the latency
+// distribution measured from each message's scheduled send time (see
+// ipclat.h).  LIST is comma separated; A:B doubles from A up to B, e.g.
+// --rate 1000:128000 ramps toward saturation in seven steps.
+//
+// --batch LIST coalesces small messages: --count framed messages (a
+// frame_hdr_t and --size payload bytes each) go out N per writev() call,
+// and the child splits whatever each read() returns back into frames.
+// Messages fall due at a fixed --pace (messages/sec, default BATCH_PACE)
+// and a batch is written when its last message is due, so each message's
+// latency, from when it was due to the receiving read(), includes the wait
+// for its batch to fill.  For each batch size the child reports
+// messages/sec, reads per message and that latency.  LIST uses the same
+// syntax as --rate, e.g. --batch 1:256.  --pace 0 drops the schedule:
+// batches are written as fast as the socket takes them, so messages/sec is
+// the saturation throughput for each batch size, and latency (from the
+// write) is mostly time queued in the socket; use a paced run for that.
+//
+// --codec raw|tlv sends structured records instead of opaque bytes: as
+// many as fit raw in --size, encoded by the parent before the transfer and
+// decoded by the child after it (see ipcrecord.h).  Encode and decode
+// times are reported apart from the transfer time.
+//
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/time.h>
@@ -19,17 +45,45 @@
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <limits.h>
+#include "perfcount.h"
+#include "crc32c.h"
+#include "ipcstream.h"
+#include "ipcresult.h"
+#include "ipcpayload.h"
+#include "ipcrecord.h"
+#include "ipctrace.h"
+#include "ipclat.h"
 
 #define TCP_PORT 54321
 #define LOCALHOST "127.0.0.1"
+#define MAX_STEPS 64
+#define BATCH_PACE 50000   // Messages/sec offered in batched mode
 
 typedef struct {
     struct timeval start;
     struct timeval end;
-    uint32_t size;
+    uint64_t size;
+    uint32_t crc;       // CRC32C of data[], set by the sender with --verify
     uint8_t data[];
 } buf_data_t;
 
+// Open-loop mode: sent in front of every message's payload
+typedef struct {
+    uint64_t intended_ns;  // Scheduled send time, CLOCK_MONOTONIC
+    uint64_t seq;
+} openloop_hdr_t;
+
+// Batched mode: in front of every message, so the receiver can split reads
+typedef struct {
+    uint32_t len;          // Payload bytes that follow
+    uint32_t seq;
+    uint64_t due_ns;       // When the --pace schedule had it due, CLOCK_MONOTONIC
+} frame_hdr_t;
+
 volatile sig_atomic_t sigusr1_received = 0;
 
 void handle_sigusr1(int sig) {
@@ -46,61 +100,579 @@ ssize_t full_write(int fd, const void *buf, size_t count) {
     return written;
 }
 
-ssize_t full_read(int fd, void *buf, size_t count) {
+ssize_t full_read(int fd, void *buf, size_t count, ipc_trace_t *trace) {
     size_t read_bytes = 0;
     while (read_bytes < count) {
         ssize_t res = read(fd, (char *)buf + read_bytes, count - read_bytes);
         if (res <= 0) return res;
+        if (read_bytes == 0) ipc_trace_mark(trace, IPC_TRACE_CHILD, "first chunk");
         read_bytes += res;
     }
+    ipc_trace_mark(trace, IPC_TRACE_CHILD, "last chunk");
     return read_bytes;
 }
 
+// Streaming mode: the header, then the payload one window at a time from
+// the pattern buffer, then a CRC32C trailer when verifying
+int stream_send(int fd, buf_data_t *hdr, const uint8_t *ref, size_t window, int verify) {
+    if (full_write(fd, hdr, sizeof(buf_data_t)) != sizeof(buf_data_t)) return -1;
+
+    uint32_t crc = 0;
+    for (uint64_t off = 0; off < hdr->size; off += window) {
+        size_t n = hdr->size - off < window ? (size_t)(hdr->size - off) : window;
+        const uint8_t *p = stream_pattern_at(ref, off);
+        if (verify == 2) crc = crc32c(crc, p, n);
+        if (full_write(fd, p, n) != n) return -1;
+    }
+
+    if (verify) {
+        // --verify computed the expected CRC before the start timestamp
+        uint32_t trailer = verify == 2 ? crc : hdr->crc;
+        if (full_write(fd, &trailer, sizeof(trailer)) != sizeof(trailer)) return -1;
+    }
+    return 0;
+}
+
+// Drains a streamed payload of size bytes through dst->data, which holds
+// one window.  The received CRC has to be chained per window; its time is
+// returned in crc_time so that --verify can leave it out of the transfer.
+int stream_receive(int fd, buf_data_t *dst, uint64_t size, size_t window, int verify,
+                   uint32_t *crc, double *crc_time, ipc_trace_t *trace) {
+    if (full_read(fd, dst, sizeof(buf_data_t), NULL) != sizeof(buf_data_t)) return -1;
+    ipc_trace_mark(trace, IPC_TRACE_CHILD, "first chunk");
+
+    *crc = 0;
+    *crc_time = 0;
+    for (uint64_t off = 0; off < size; off += window) {
+        size_t n = size - off < window ? (size_t)(size - off) : window;
+        if (full_read(fd, dst->data, n, NULL) != n) return -1;
+        if (verify) {
+            uint64_t t0 = lat_now_ns();
+            *crc = crc32c(*crc, dst->data, n);
+            *crc_time += (lat_now_ns() - t0) / 1e9;
+        }
+    }
+
+    if (verify) {
+        if (full_read(fd, &dst->crc, sizeof(dst->crc), NULL) != sizeof(dst->crc)) return -1;
+    }
+    ipc_trace_mark(trace, IPC_TRACE_CHILD, "last chunk");
+    return 0;
+}
+
+// One step per rate: count messages on a fixed schedule, then wait for
+// the receiver's one-byte acknowledgement so steps do not overlap
+int openloop_send(int fd, const double *rates, int nrates, uint64_t count,
+                  const uint8_t *payload, uint64_t size) {
+    openloop_hdr_t hdr;
+    struct iovec iov[2] = { { &hdr, sizeof(hdr) }, { (void *)payload, size } };
+
+    for (int r = 0; r < nrates; r++) {
+        double interval = 1e9 / rates[r];
+        uint64_t t0 = lat_now_ns() + 1000000;  // Start 1 ms out, on schedule
+
+        for (uint64_t i = 0; i < count; i++) {
+            hdr.intended_ns = t0 + (uint64_t)(i * interval);
+            hdr.seq = i;
+            // Never skip or delay the schedule: late messages go out at once
+            lat_wait_until(hdr.intended_ns);
+
+            size_t want = sizeof(hdr) + size;
+            ssize_t n = writev(fd, iov, 2);
+            if (n < 0) return -1;
+            if ((size_t)n < want) {
+                // Short write: finish the remainder of this message
+                size_t done = n;
+                if (done < sizeof(hdr)) {
+                    if (full_write(fd, (char *)&hdr + done, sizeof(hdr) - done) < 0) return -1;
+                    done = sizeof(hdr);
+                }
+                if (full_write(fd, payload + (done - sizeof(hdr)), want - done) < 0) return -1;
+            }
+        }
+
+        char ack;
+        if (full_read(fd, &ack, 1, NULL) != 1) return -1;
+    }
+    return 0;
+}
+
+int openloop_receive(int fd, const double *rates, int nrates, uint64_t count, uint64_t size,
+                     int verify, int format, const char *output) {
+    // With --verify every message of a step is kept and checked after it,
+    // so the receive loop only reads and timestamps
+    size_t msg_size = sizeof(openloop_hdr_t) + size;
+    uint8_t *msgs = malloc((verify ? count : 1) * msg_size);
+    double *lat = malloc(count * sizeof(double));
+    if (!msgs || !lat) {
+        perror(verify ? "Child malloc (--verify keeps a whole step)" : "Child malloc");
+        free(msgs);
+        free(lat);
+        return -1;
+    }
+
+    // Every payload is the same 0, 1, 2, ... pattern
+    uint32_t expected = 0;
+    if (verify) {
+        for (uint64_t i = 0; i < size; i++) msgs[sizeof(openloop_hdr_t) + i] = (uint8_t)i;
+        expected = crc32c(0, msgs + sizeof(openloop_hdr_t), size);
+    }
+
+    printf("[Child] Open loop:    %" PRIu64 " messages of %" PRIu64 " bytes per step\n", count, size);
+    lat_print_header("[Child] ", "Offered/s");
+
+    int rc = 0;
+    uint64_t mismatches = 0;
+    for (int r = 0; r < nrates && rc == 0; r++) {
+        uint64_t first = 0, last = 0;
+        for (uint64_t i = 0; i < count; i++) {
+            uint8_t *msg = msgs + (verify ? i * msg_size : 0);
+            if (full_read(fd, msg, msg_size, NULL) != msg_size) {
+                fprintf(stderr, "Child: Failed to read message %" PRIu64 "\n", i);
+                rc = -1;
+                break;
+            }
+            last = lat_now_ns();
+
+            openloop_hdr_t hdr;
+            memcpy(&hdr, msg, sizeof(hdr));
+            if (i == 0) first = hdr.intended_ns;
+            lat[i] = (double)(int64_t)(last - hdr.intended_ns) / 1e9;
+        }
+        if (rc < 0) break;
+
+        // Outside the step for --verify-timed as well: inside, it would delay the next read
+        uint64_t bad = 0;
+        for (uint64_t i = 0; verify && i < count; i++) {
+            if (crc32c(0, msgs + i * msg_size + sizeof(openloop_hdr_t), size) != expected) bad++;
+        }
+        mismatches += bad;
+
+        ipc_latency_t l = { .rate = rates[r] };
+        lat_summarize(lat, count, &l);
+        double span = (last - first) / 1e9;
+        lat_print("[Child] ", rates[r], span > 0 ? count / span : 0, &l);
+
+        // elapsed is the cost per message, so bytes_per_sec is the payload throughput
+        char label[64];
+        snprintf(label, sizeof(label), "tcp-rate-%.0f", rates[r]);
+        ipc_result_t result = { label, size, span / count, verify ? bad == 0 : -1, &l };
+        result_emit(format, output, &result);
+
+        char ack = 1;
+        if (full_write(fd, &ack, 1) != 1) rc = -1;
+    }
+
+    if (verify) {
+        if (mismatches) printf("[Child] Verified:     FAILED (%" PRIu64 " messages with a bad crc32c)\n", mismatches);
+        else printf("[Child] Verified:     OK (crc32c 0x%08x, %s)\n", expected, crc32c_impl());
+        if (mismatches) rc = -1;
+    }
+
+    free(msgs);
+    free(lat);
+    return rc;
+}
+
+// writev() until every iovec has gone out, advancing past short writes
+int full_writev(int fd, struct iovec *iov, int cnt) {
+    while (cnt > 0) {
+        ssize_t n = writev(fd, iov, cnt > IOV_MAX ? IOV_MAX : cnt);
+        if (n <= 0) return -1;
+        while (cnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            iov++;
+            cnt--;
+        }
+        if (cnt > 0) {
+            iov->iov_base = (char *)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return 0;
+}
+
+// One step per batch size: count frames on the pace schedule (or as fast
+// as the socket takes them with pace 0), batch at a time per writev(),
+// then wait for the receiver's acknowledgement
+int batch_send(int fd, const double *batches, int nbatches, uint64_t count, double pace,
+               const uint8_t *payload, uint64_t size) {
+    double interval = pace > 0 ? 1e9 / pace : 0;
+    for (int b = 0; b < nbatches; b++) {
+        int batch = (int)batches[b];
+        frame_hdr_t *hdrs = malloc(batch * sizeof(frame_hdr_t));
+        struct iovec *iov = malloc(2 * batch * sizeof(struct iovec));
+        if (!hdrs || !iov) {
+            free(hdrs);
+            free(iov);
+            return -1;
+        }
+
+        uint64_t t0 = lat_now_ns() + 1000000;  // Start 1 ms out, on schedule
+        for (uint64_t seq = 0; seq < count; seq += batch) {
+            int n = count - seq < (uint64_t)batch ? (int)(count - seq) : batch;
+            uint64_t now = pace > 0 ? 0 : lat_now_ns();  // Unpaced: due when sent
+            for (int i = 0; i < n; i++) {
+                uint64_t due = pace > 0 ? t0 + (uint64_t)((seq + i) * interval) : now;
+                hdrs[i] = (frame_hdr_t){ (uint32_t)size, (uint32_t)(seq + i), due };
+                iov[2 * i] = (struct iovec){ &hdrs[i], sizeof(frame_hdr_t) };
+                iov[2 * i + 1] = (struct iovec){ (void *)payload, size };
+            }
+            // Like open loop, a late batch goes out at once and is charged for it
+            if (pace > 0) lat_wait_until(hdrs[n - 1].due_ns);
+            if (full_writev(fd, iov, 2 * n) < 0) {
+                free(hdrs);
+                free(iov);
+                return -1;
+            }
+        }
+        free(hdrs);
+        free(iov);
+
+        char ack;
+        if (full_read(fd, &ack, 1, NULL) != 1) return -1;
+    }
+    return 0;
+}
+
+// Reads up to a batch of frames per read() and splits them by their
+// headers; a partial frame at the end of a read waits for the next one.
+// With --verify the frames of a step stay where they were read and are
+// checked after it, so the receive loop only reads, splits and timestamps.
+int batch_receive(int fd, const double *batches, int nbatches, uint64_t count, double pace,
+                  uint64_t size, int verify, int format, const char *output) {
+    size_t frame = sizeof(frame_hdr_t) + size;
+    int max_batch = 1;
+    for (int b = 0; b < nbatches; b++) {
+        if (batches[b] > max_batch) max_batch = (int)batches[b];
+    }
+    uint8_t *buf = malloc((verify ? count : 0) * frame + max_batch * frame);
+    double *lat = malloc(count * sizeof(double));
+    if (!buf || !lat) {
+        perror(verify ? "Child malloc (--verify keeps a whole step)" : "Child malloc");
+        free(buf);
+        free(lat);
+        return -1;
+    }
+
+    // Every payload is the same 0, 1, 2, ... pattern
+    uint32_t expected = 0;
+    if (verify) {
+        for (uint64_t i = 0; i < size; i++) buf[i] = (uint8_t)i;
+        expected = crc32c(0, buf, size);
+    }
+
+    char paced[32] = "unpaced";
+    if (pace > 0) snprintf(paced, sizeof(paced), "%.0f/sec", pace);
+    printf("[Child] Batched:      %" PRIu64 " messages of %" PRIu64 " bytes per step, %s\n", count, size, paced);
+    lat_print_header("[Child] ", "Batch");
+
+    int rc = 0;
+    uint64_t mismatches = 0;
+    for (int b = 0; b < nbatches && rc == 0; b++) {
+        size_t cap = (size_t)batches[b] * frame, have = 0;
+        uint64_t got = 0, reads = 0, first = 0, last = 0;
+        uint8_t *win = buf;
+
+        while (got < count) {
+            ssize_t n = read(fd, win + have, cap - have);
+            if (n <= 0) {
+                fprintf(stderr, "Child: Failed to read message %" PRIu64 "\n", got);
+                rc = -1;
+                break;
+            }
+            last = lat_now_ns();
+            reads++;
+            have += n;
+
+            size_t off = 0;
+            while (have - off >= frame && got < count) {
+                frame_hdr_t hdr;
+                memcpy(&hdr, win + off, sizeof(hdr));
+                if (hdr.len != size || hdr.seq != got) {
+                    fprintf(stderr, "Child: Bad frame %" PRIu64 " (len %u, seq %u)\n", got, hdr.len, hdr.seq);
+                    rc = -1;
+                    break;
+                }
+                if (got == 0) first = hdr.due_ns;
+                lat[got++] = (double)(int64_t)(last - hdr.due_ns) / 1e9;
+                off += frame;
+            }
+            if (rc < 0) break;
+            if (verify) {
+                win += off;
+            } else {
+                memmove(buf, buf + off, have - off);
+            }
+            have -= off;
+        }
+        if (rc < 0) break;
+
+        uint64_t bad = 0;
+        for (uint64_t i = 0; verify && i < count; i++) {
+            if (crc32c(0, buf + i * frame + sizeof(frame_hdr_t), size) != expected) bad++;
+        }
+        mismatches += bad;
+
+        ipc_latency_t l = { .rate = pace };
+        lat_summarize(lat, count, &l);
+        double span = (last - first) / 1e9;
+        lat_print("[Child] ", batches[b], span > 0 ? count / span : 0, &l);
+        printf("[Child]              %.3f reads/message, %.2f MB/sec\n", (double)reads / count,
+               span > 0 ? count * size / span / 1e6 : 0);
+
+        // elapsed is the cost per message, so bytes_per_sec is the payload throughput
+        char label[64];
+        snprintf(label, sizeof(label), "tcp-batch-%d", (int)batches[b]);
+        ipc_result_t result = { label, size, span / count, verify ? bad == 0 : -1, &l };
+        result_emit(format, output, &result);
+
+        char ack = 1;
+        if (full_write(fd, &ack, 1) != 1) rc = -1;
+    }
+
+    if (verify) {
+        if (mismatches) printf("[Child] Verified:     FAILED (%" PRIu64 " messages with a bad crc32c)\n", mismatches);
+        else printf("[Child] Verified:     OK (crc32c 0x%08x, %s)\n", expected, crc32c_impl());
+        if (mismatches) rc = -1;
+    }
+
+    free(buf);
+    free(lat);
+    return rc;
+}
+
 int main(int argc, char *argv[]) {
-    int size = 0;
+    uint64_t size = 0;
+    int perf = 0;
+    int trace_table = 0;
+    const char *trace_json = NULL;
+    int verify = 0;  // 1: checksum outside the timed region, 2: inside
+    uint64_t window = 0;  // Streaming window; 0 sends the payload in one piece
+    double rates[MAX_STEPS];
+    int nrates = 0;       // Open loop when non-zero
+    double batches[MAX_STEPS];
+    int nbatches = 0;     // Batched when non-zero
+    double pace = -1;     // Batched messages/sec, 0 unpaced; -1 until set, then BATCH_PACE
+    uint64_t count = 10000;  // Messages per open-loop or batch step
+    int format = RESULT_TEXT;
+    const char *output = NULL;  // Append records here instead of stdout
+    int pattern = PATTERN_SEQ;
+    long src_align = -1, dst_align = -1;  // Payload offsets in a page; -1 leaves malloc() placement
+    int codec = -1;       // Structured records (ipcrecord.h); -1 for opaque bytes
 
     static struct option long_options[] = {
         {"size", required_argument, 0, 's'},
+        {"perf", no_argument, 0, 'P'},
+        {"trace", no_argument, 0, 'T'},
+        {"trace-json", required_argument, 0, 'J'},
+        {"verify", no_argument, 0, 'V'},
+        {"verify-timed", no_argument, 0, 'I'},
+        {"window", required_argument, 0, 'w'},
+        {"rate", required_argument, 0, 'r'},
+        {"count", required_argument, 0, 'c'},
+        {"batch", required_argument, 0, 'b'},
+        {"pace", required_argument, 0, 'p'},
+        {"pattern", required_argument, 0, 'D'},
+        {"align", required_argument, 0, 'A'},
+        {"codec", required_argument, 0, 'C'},
+        {"format", required_argument, 0, 'f'},
+        {"output", required_argument, 0, 'o'},
         {0, 0, 0, 0}
     };
 
     while (1) {
         int option_index = 0;
-        int c = getopt_long(argc, argv, "s:", long_options, &option_index);
+        int c = getopt_long(argc, argv, "s:PTJ:VIw:r:c:b:p:D:A:C:f:o:", long_options, &option_index);
         if (c == -1) break;
 
         switch (c) {
             case 's':
-                size = atoi(optarg);
+                if (parse_size(optarg, &size) < 0) {
+                    fprintf(stderr, "Invalid size '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'P':
+                perf = 1;
+                break;
+            case 'T':
+                trace_table = 1;
+                break;
+            case 'J':
+                trace_json = optarg;
+                break;
+            case 'V':
+                verify = 1;
+                break;
+            case 'I':
+                verify = 2;
+                break;
+            case 'w':
+                if (parse_size(optarg, &window) < 0 || window == 0 || window > SIZE_MAX - 256) {
+                    fprintf(stderr, "Invalid window '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'r':
+                nrates = lat_parse_steps(optarg, rates, MAX_STEPS);
+                if (nrates <= 0) {
+                    fprintf(stderr, "Invalid rate '%s' (e.g. 1000,5000 or 1000:64000).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'c':
+                if (parse_size(optarg, &count) < 0 || count == 0 || count > UINT32_MAX) {
+                    fprintf(stderr, "Invalid count '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'b':
+                nbatches = lat_parse_steps(optarg, batches, MAX_STEPS);
+                for (int i = 0; i < nbatches; i++) {
+                    if (batches[i] < 1 || batches[i] > IOV_MAX / 2 || batches[i] != (int)batches[i]) nbatches = -1;
+                }
+                if (nbatches <= 0) {
+                    fprintf(stderr, "Invalid batch '%s' (1 to %d, e.g. 1,8,64 or 1:256).\n", optarg, IOV_MAX / 2);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'p': {
+                char *end;
+                pace = strtod(optarg, &end);
+                if (end == optarg || *end || pace < 0) {
+                    fprintf(stderr, "Invalid pace '%s' (messages/sec, 0 for unpaced).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case 'D':
+                pattern = payload_pattern_parse(optarg);
+                if (pattern < 0) {
+                    fprintf(stderr, "Invalid pattern '%s' (expected seq, random or zero).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'A':
+                if (payload_align_parse(optarg, &src_align, &dst_align) < 0) {
+                    fprintf(stderr, "Invalid alignment '%s' (SRC[,DST] bytes past a page boundary).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'C':
+                codec = record_codec_parse(optarg, 0);
+                if (codec < 0) {
+                    fprintf(stderr, "Invalid codec '%s' (expected raw or tlv).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'f':
+                format = result_format_parse(optarg);
+                if (format < 0) {
+                    fprintf(stderr, "Invalid format '%s' (expected text, json or csv).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'o':
+                output = optarg;
                 break;
             default:
-                fprintf(stderr, "Usage: %s --size NUMBER\n", argv[0]);
+                fprintf(stderr, "Usage: %s --size NUMBER [--perf] [--trace] [--trace-json FILE] [--verify|--verify-timed] [--window BYTES] [--rate LIST | --batch LIST [--pace R]] [--count N] [--pattern seq|random|zero] [--align SRC[,DST]] [--codec raw|tlv] [--format text|json|csv] [--output FILE]\n", argv[0]);
                 return EXIT_FAILURE;
         }
     }
 
-    if (size <= 0) {
+    result_redirect_text(format, output);
+
+    if (size == 0) {
         fprintf(stderr, "Invalid size specified.\n");
         return EXIT_FAILURE;
     }
+    if ((window || nrates || nbatches) && (pattern != PATTERN_SEQ || src_align >= 0)) {
+        fprintf(stderr, "--pattern and --align apply to single transfers only.\n");
+        return EXIT_FAILURE;
+    }
+    if (codec >= 0 && (window || nrates || nbatches || pattern != PATTERN_SEQ)) {
+        fprintf(stderr, "--codec applies to single transfers and makes its own payload.\n");
+        return EXIT_FAILURE;
+    }
+    if ((nrates != 0) + (nbatches != 0) + (window != 0) > 1) {
+        fprintf(stderr, "--rate, --batch and --window cannot be combined.\n");
+        return EXIT_FAILURE;
+    }
+    if (pace >= 0 && !nbatches) {
+        fprintf(stderr, "--pace applies to --batch only.\n");
+        return EXIT_FAILURE;
+    }
+    if (pace < 0) pace = BATCH_PACE;
+    if (nbatches && size > UINT32_MAX) {
+        fprintf(stderr, "Batched messages are limited to %u bytes.\n", UINT32_MAX);
+        return EXIT_FAILURE;
+    }
+
+    // Records are encoded into the payload buffer, so size it for the codec
+    uint64_t nrecords = 0;
+    if (codec >= 0) {
+        nrecords = record_count(size);
+        size = record_max_size(codec, nrecords);
+    }
 
-    size_t total_size = sizeof(buf_data_t) + size;
+    // In streaming mode only the header is materialised; the payload is
+    // served from a window-sized pattern buffer (see ipcstream.h)
+    size_t total_size = sizeof(buf_data_t) + (window ? 0 : size);
 
-    buf_data_t *src = malloc(total_size);
+    payload_buf_t sb;
+    buf_data_t *src = payload_alloc(&sb, sizeof(buf_data_t), window ? 0 : size, src_align, pattern == PATTERN_ZERO);
     if (!src) {
         perror("malloc");
         return EXIT_FAILURE;
     }
 
     src->size = size;
-    for (int i = 0; i < size; i++) {
-        src->data[i] = (uint8_t)i;
+    uint8_t *ref = NULL;
+    if (window) {
+        ref = stream_pattern_alloc(window);
+        if (!ref) {
+            perror("malloc");
+            payload_free(&sb);
+            return EXIT_FAILURE;
+        }
+    } else if (codec < 0) {
+        payload_fill(src->data, size, pattern);
     }
 
+    // Encoded before fork, so the child has the time for its report
+    double encode_time = 0;
+    if (codec >= 0) {
+        ipc_record_t *records = malloc(nrecords * sizeof(ipc_record_t));
+        if (!records) {
+            perror("malloc");
+            payload_free(&sb);
+            return EXIT_FAILURE;
+        }
+        for (uint64_t i = 0; i < nrecords; i++) record_generate(&records[i], i);
+        memset(src->data, 0, size);   // Time the codec, not first-touch faults
+
+        uint64_t t0 = lat_now_ns();
+        size = record_encode(codec, records, nrecords, src->data);
+        encode_time = (lat_now_ns() - t0) / 1e9;
+        free(records);
+
+        src->size = size;
+        total_size = sizeof(buf_data_t) + size;
+    }
+
+    // Shared between parent and child, so it must exist before fork
+    ipc_trace_t *trace = NULL;
+    if (trace_table || trace_json) trace = ipc_trace_create();
+
+    // Install before fork so the child's ready signal cannot arrive first
+    signal(SIGUSR1, handle_sigusr1);
+
     pid_t child_pid = fork();
     if (child_pid < 0) {
         perror("fork");
-        free(src);
+        payload_free(&sb);
         return EXIT_FAILURE;
     }
 
@@ -133,6 +705,10 @@ int main(int argc, char *argv[]) {
             exit(EXIT_FAILURE);
         }
 
+        perf_counters_t pc;
+        if (perf) perf_counters_open(&pc);
+        if (perf) perf_counters_start(&pc);
+
         kill(getppid(), SIGUSR1); // Notify parent
 
         int client_fd = accept(server_fd, NULL, NULL);
@@ -142,7 +718,8 @@ int main(int argc, char *argv[]) {
             exit(EXIT_FAILURE);
         }
 
-        buf_data_t *dst = malloc(total_size);
+        payload_buf_t db;
+        buf_data_t *dst = payload_alloc(&db, sizeof(buf_data_t), window ? window : size, dst_align, 0);
         if (!dst) {
             perror("Child malloc");
             close(client_fd);
@@ -150,16 +727,61 @@ int main(int argc, char *argv[]) {
             exit(EXIT_FAILURE);
         }
 
-        ssize_t n = full_read(client_fd, dst, total_size);
-        if (n != total_size) {
+        // Only when tracing: separate the wakeup from the first read
+        if (trace) {
+            struct pollfd pfd = { .fd = client_fd, .events = POLLIN };
+            poll(&pfd, 1, -1);
+            ipc_trace_mark(trace, IPC_TRACE_CHILD, "receiver wakeup");
+        }
+
+        if (nrates) {
+            int ok = openloop_receive(client_fd, rates, nrates, count, size, verify, format, output) == 0;
+            if (perf) {
+                perf_counters_stop(&pc);
+                perf_counters_print(&pc, "[Child] ");
+                perf_counters_close(&pc);
+            }
+            payload_free(&db);
+            close(client_fd);
+            close(server_fd);
+            exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+
+        if (nbatches) {
+            int ok = batch_receive(client_fd, batches, nbatches, count, pace, size, verify, format, output) == 0;
+            if (perf) {
+                perf_counters_stop(&pc);
+                perf_counters_print(&pc, "[Child] ");
+                perf_counters_close(&pc);
+            }
+            payload_free(&db);
+            close(client_fd);
+            close(server_fd);
+            exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+
+        uint32_t crc = 0;
+        double crc_time = 0;   // Spent on the chained CRC while streaming
+        int failed;
+        if (window) {
+            failed = stream_receive(client_fd, dst, size, window, verify, &crc, &crc_time, trace) < 0;
+        } else {
+            failed = full_read(client_fd, dst, total_size, trace) != total_size;
+        }
+        if (failed) {
             fprintf(stderr, "Child: Failed to read complete buffer\n");
-            free(dst);
+            payload_free(&db);
             close(client_fd);
             close(server_fd);
             exit(EXIT_FAILURE);
         }
 
+        if (verify == 2 && !window) crc = crc32c(0, dst->data, size);
+
         gettimeofday(&dst->end, NULL);
+        if (perf) perf_counters_stop(&pc);
+
+        if (verify == 1 && !window) crc = crc32c(0, dst->data, size);
 
         long sec = dst->end.tv_sec - dst->start.tv_sec;
         long usec = dst->end.tv_usec - dst->start.tv_usec;
@@ -168,28 +790,66 @@ int main(int argc, char *argv[]) {
             usec += 1000000;
         }
 
-        double elapsed = sec + usec / 1e6;
+        // --verify keeps the checksum out of the transfer time, even interleaved
+        double elapsed = sec + usec / 1e6 - (verify == 1 ? crc_time : 0);
         double bps = elapsed > 0 ? (dst->size / elapsed) : 0;
         double mbps = bps / 1e6;
 
         printf("[Child] Elapsed Time: %.6f seconds\n", elapsed);
-        printf("[Child] Transferred:  %u bytes\n", dst->size);
+        printf("[Child] Transferred:  %" PRIu64 " bytes\n", dst->size);
         printf("[Child] Throughput:   %.2f bytes/sec (%.2f MB/sec)\n", bps, mbps);
+        result_print_peak("[Child] ", bps);
+        ipc_trace_mark(trace, IPC_TRACE_CHILD, "post-processing");
+        if (perf) {
+            perf_counters_print(&pc, "[Child] ");
+            perf_counters_close(&pc);
+        }
+
+        int ok = !verify || (crc32c_report_size("[Child] ", size, dst->size) == 0 &&
+                                crc32c_report("[Child] ", dst->crc, crc) == 0);
+
+        ipc_codec_t cd = { NULL };
+        char label[32];
+        snprintf(label, sizeof(label), "%s", window ? "tcp-window" : "tcp");
+        if (codec >= 0) {
+            ipc_record_t *records = malloc(nrecords * sizeof(ipc_record_t));
+            if (!records) {
+                perror("Child malloc");
+                exit(EXIT_FAILURE);
+            }
+            memset(records, 0, nrecords * sizeof(ipc_record_t));
+            uint64_t t0 = lat_now_ns();
+            int64_t got = record_decode(codec, dst->data, size, records, nrecords);
+            double decode_time = (lat_now_ns() - t0) / 1e9;
+
+            record_print("[Child] ", record_codec_names[codec], nrecords, dst->size, encode_time, elapsed, decode_time);
+            if (got != (int64_t)nrecords || record_check(records, nrecords) != 0) {
+                printf("[Child] Decoded:      FAILED\n");
+                ok = 0;
+            }
+            free(records);
+
+            cd = (ipc_codec_t){ record_codec_names[codec], nrecords, encode_time, decode_time };
+            snprintf(label, sizeof(label), "tcp-%s", record_codec_names[codec]);
+        }
+
+        long src_offset = payload_offset(src_align, pattern == PATTERN_ZERO);
+        ipc_payload_t pl = { payload_pattern_names[pattern], src_offset, dst_align };
+        ipc_result_t result = { label, dst->size, elapsed, verify ? ok : -1, NULL, &pl, codec >= 0 ? &cd : NULL };
+        result_emit(format, output, &result);
 
-        free(dst);
+        payload_free(&db);
         close(client_fd);
         close(server_fd);
-        exit(EXIT_SUCCESS);
+        exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
     } else {
         // --- Parent Process (TCP Client) ---
-        signal(SIGUSR1, handle_sigusr1);
-
         while (!sigusr1_received) pause(); // Wait for child to bind
 
         int sockfd = socket(AF_INET, SOCK_STREAM, 0);
         if (sockfd < 0) {
             perror("Parent socket");
-            free(src);
+            payload_free(&sb);
             return EXIT_FAILURE;
         }
 
@@ -202,20 +862,60 @@ int main(int argc, char *argv[]) {
         if (connect(sockfd, (struct sockaddr *)&serv_addr, sizeof(serv_addr)) < 0) {
             perror("Parent connect");
             close(sockfd);
-            free(src);
+            payload_free(&sb);
             return EXIT_FAILURE;
         }
 
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "connected");
+
+        // Small open-loop messages must not wait for Nagle's algorithm; batching
+        // is the explicit alternative, so it must not be helped by it either
+        if (nrates || nbatches) setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &(int){ 1 }, sizeof(int));
+
+        if (verify == 1) {
+            src->crc = window ? stream_pattern_crc(ref, size, window) : crc32c(0, src->data, size);
+        }
+
+        perf_counters_t pc;
+        if (perf) perf_counters_open(&pc);
+
+        if (perf) perf_counters_start(&pc);
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "pre-send");
         gettimeofday(&src->start, NULL);
 
-        ssize_t sent = full_write(sockfd, src, total_size);
-        if (sent != total_size) {
+        if (verify == 2 && !window) src->crc = crc32c(0, src->data, size);
+
+        int failed;
+        if (nrates) {
+            failed = openloop_send(sockfd, rates, nrates, count, src->data, size) < 0;
+        } else if (nbatches) {
+            failed = batch_send(sockfd, batches, nbatches, count, pace, src->data, size) < 0;
+        } else if (window) {
+            failed = stream_send(sockfd, src, ref, window, verify) < 0;
+        } else {
+            failed = full_write(sockfd, src, total_size) != total_size;
+        }
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "send return");
+        if (failed) {
             fprintf(stderr, "Parent: Failed to send complete buffer\n");
         }
+        if (perf) perf_counters_stop(&pc);
 
         close(sockfd);
-        wait(NULL);
-        free(src);
+        int status;
+        wait(&status);
+        if (perf) {
+            perf_counters_print(&pc, "[Parent] ");
+            perf_counters_close(&pc);
+        }
+
+        if (trace_table) ipc_trace_print_table(trace);
+        if (trace_json) ipc_trace_write_chrome(trace, trace_json);
+        ipc_trace_destroy(trace);
+        free(ref);
+        payload_free(&sb);
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) return EXIT_FAILURE;
     }
 
     return EXIT_SUCCESS;
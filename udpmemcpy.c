@@ -5,6 +5,19 @@
 //
 // To build: gcc -Wall udpmemcpy.c -o udpmemcpy
 //
+// --batch LIST sends --count framed datagrams (a frame_hdr_t and --size
+// payload bytes each) per step, N per sendmmsg() call, and the child
+// receives them with recvmmsg().  Datagrams fall due at a fixed --pace
+// (messages/sec, default BATCH_PACE) and a batch is sent when its last
+// datagram is due, so latency, from when a datagram was due to the
+// receiving recvmmsg(), includes the wait for its batch to fill.  For each
+// batch size the child reports messages/sec, receive calls per message,
+// datagrams lost (the sender is not flow controlled) and that latency.
+// LIST is a comma list or A:B, e.g. --batch 1:256.  --pace 0 drops the
+// schedule: batches are sent as fast as the socket takes them, so
+// messages/sec is the saturation throughput for each batch size, and
+// latency (from the send) is mostly time queued; use a paced run for that.
+//
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
@@ -19,68 +32,399 @@
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <poll.h>
+#include <inttypes.h>
+#include <sys/uio.h>
+#include "perfcount.h"
+#include "crc32c.h"
+#include "ipcstream.h"
+#include "ipcresult.h"
+#include "ipcpayload.h"
+#include "ipctrace.h"
+#include "ipclat.h"
 
 #define UDP_PORT 54321
 #define LOCALHOST "127.0.0.1"
+#define UDP_MAX_PAYLOAD 65507   // IPv4 datagram limit
+#define MAX_STEPS 64
+#define MAX_BATCH 1024          // UIO_MAXIOV, the sendmmsg()/recvmmsg() limit
+#define BATCH_RCVBUF (8 << 20)  // Requested; the kernel caps it at rmem_max
+#define BATCH_TIMEOUT_MS 1000   // Silence that ends a step with losses
+#define BATCH_PACE 50000        // Datagrams/sec offered in batched mode
 
 typedef struct {
     struct timeval start;
     struct timeval end;
-    uint32_t size;
+    uint64_t size;
+    uint32_t crc;       // CRC32C of data[], set by the sender with --verify
     uint8_t data[];
 } buf_data_t;
 
+// Batched mode: in front of every datagram's payload
+typedef struct {
+    uint32_t len;          // Payload bytes that follow
+    uint32_t seq;
+    uint64_t due_ns;       // When the --pace schedule had it due, CLOCK_MONOTONIC
+} frame_hdr_t;
+
 volatile sig_atomic_t sigusr1_received = 0;
 
 void handle_sigusr1(int sig) {
     sigusr1_received = 1;
 }
 
+// One step per batch size: count datagrams on the pace schedule (or as
+// fast as the socket takes them with pace 0), batch at a time per
+// sendmmsg(), then wait for the receiver's acknowledgement
+int batch_send(int fd, const double *batches, int nbatches, uint64_t count, double pace,
+               const uint8_t *payload, uint64_t size) {
+    double interval = pace > 0 ? 1e9 / pace : 0;
+    frame_hdr_t *hdrs = malloc(MAX_BATCH * sizeof(frame_hdr_t));
+    struct iovec *iov = malloc(2 * MAX_BATCH * sizeof(struct iovec));
+    struct mmsghdr *msgs = calloc(MAX_BATCH, sizeof(struct mmsghdr));
+    if (!hdrs || !iov || !msgs) {
+        free(hdrs);
+        free(iov);
+        free(msgs);
+        return -1;
+    }
+
+    // The acknowledgement must not be waited for forever if it is dropped
+    struct timeval tv = { 10, 0 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    int rc = 0;
+    for (int b = 0; b < nbatches && rc == 0; b++) {
+        int batch = (int)batches[b];
+        uint64_t t0 = lat_now_ns() + 1000000;  // Start 1 ms out, on schedule
+        for (uint64_t seq = 0; seq < count && rc == 0; seq += batch) {
+            int n = count - seq < (uint64_t)batch ? (int)(count - seq) : batch;
+            uint64_t now = pace > 0 ? 0 : lat_now_ns();  // Unpaced: due when sent
+            for (int i = 0; i < n; i++) {
+                uint64_t due = pace > 0 ? t0 + (uint64_t)((seq + i) * interval) : now;
+                hdrs[i] = (frame_hdr_t){ (uint32_t)size, (uint32_t)(seq + i), due };
+                iov[2 * i] = (struct iovec){ &hdrs[i], sizeof(frame_hdr_t) };
+                iov[2 * i + 1] = (struct iovec){ (void *)payload, size };
+                msgs[i].msg_hdr.msg_iov = &iov[2 * i];
+                msgs[i].msg_hdr.msg_iovlen = 2;
+            }
+            // Like open loop, a late batch goes out at once and is charged for it
+            if (pace > 0) lat_wait_until(hdrs[n - 1].due_ns);
+
+            // A short count means the socket buffer filled; send the rest
+            for (int done = 0; done < n;) {
+                int sent = sendmmsg(fd, msgs + done, n - done, 0);
+                if (sent < 0 && errno == ENOBUFS) {
+                    // The device queue is full: give it time to drain rather than spin
+                    struct pollfd pfd = { .fd = fd, .events = POLLOUT };
+                    poll(&pfd, 1, 1);
+                    usleep(50);
+                    continue;
+                }
+                if (sent < 0) {
+                    perror("Parent sendmmsg");
+                    rc = -1;
+                    break;
+                }
+                done += sent;
+            }
+        }
+        if (rc < 0) break;
+
+        char ack;
+        if (recv(fd, &ack, 1, 0) != 1) {
+            perror("Parent recv acknowledgement");
+            rc = -1;
+        }
+    }
+
+    free(hdrs);
+    free(iov);
+    free(msgs);
+    return rc;
+}
+
+// Receives up to a batch of datagrams per recvmmsg(); a step ends with its
+// last datagram, or after BATCH_TIMEOUT_MS of silence if that was lost.
+// With --verify each datagram of a step lands in its own slot and is
+// checked after the step, so the receive loop only receives and timestamps.
+int batch_receive(int fd, const double *batches, int nbatches, uint64_t count, double pace,
+                  uint64_t size, int verify, int format, const char *output) {
+    size_t frame = sizeof(frame_hdr_t) + size;
+    uint8_t *buf = malloc(((verify ? count : 0) + MAX_BATCH) * frame);
+    struct iovec *iov = malloc(MAX_BATCH * sizeof(struct iovec));
+    struct mmsghdr *msgs = calloc(MAX_BATCH, sizeof(struct mmsghdr));
+    double *lat = malloc(count * sizeof(double));
+    if (!buf || !iov || !msgs || !lat) {
+        perror(verify ? "Child malloc (--verify keeps a whole step)" : "Child malloc");
+        free(buf);
+        free(iov);
+        free(msgs);
+        free(lat);
+        return -1;
+    }
+
+    int rcvbuf = BATCH_RCVBUF;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    socklen_t len = sizeof(rcvbuf);
+    getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, &len);
+    struct timeval tv = { 0, BATCH_TIMEOUT_MS * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+
+    // Every payload is the same 0, 1, 2, ... pattern
+    uint32_t expected = 0;
+    if (verify) {
+        for (uint64_t i = 0; i < size; i++) buf[i] = (uint8_t)i;
+        expected = crc32c(0, buf, size);
+    }
+
+    char paced[32] = "unpaced";
+    if (pace > 0) snprintf(paced, sizeof(paced), "%.0f/sec", pace);
+    printf("[Child] Batched:      %" PRIu64 " datagrams of %" PRIu64 " bytes per step, %s (receive buffer %d bytes)\n",
+           count, size, paced, rcvbuf);
+    lat_print_header("[Child] ", "Batch");
+
+    int rc = 0;
+    uint64_t mismatches = 0;
+    for (int b = 0; b < nbatches && rc == 0; b++) {
+        int batch = (int)batches[b];
+        struct sockaddr_in from;
+        uint64_t got = 0, calls = 0, first = 0, last = 0, next = 0;
+
+        for (int i = 0; i < batch; i++) {
+            iov[i] = (struct iovec){ buf + i * frame, frame };
+            msgs[i].msg_hdr = (struct msghdr){ .msg_iov = &iov[i], .msg_iovlen = 1 };
+        }
+        // Only the first slot's source is needed, for the acknowledgement
+        msgs[0].msg_hdr.msg_name = &from;
+        msgs[0].msg_hdr.msg_namelen = sizeof(from);
+
+        while (next < count) {
+            for (int i = 0; verify && i < batch; i++) iov[i].iov_base = buf + (got + i) * frame;
+            int n = recvmmsg(fd, msgs, batch, MSG_WAITFORONE, NULL);
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;  // Rest was lost
+            if (n < 0) {
+                perror("Child recvmmsg");
+                rc = -1;
+                break;
+            }
+            uint64_t now = lat_now_ns();
+            calls++;
+            for (int i = 0; i < n; i++) {
+                frame_hdr_t hdr;
+                uint8_t *p = iov[i].iov_base;
+                memcpy(&hdr, p, sizeof(hdr));
+                if (msgs[i].msg_len != frame || hdr.len != size || hdr.seq < next || hdr.seq >= count) {
+                    fprintf(stderr, "Child: Bad datagram (%u bytes, seq %u)\n", msgs[i].msg_len, hdr.seq);
+                    rc = -1;
+                    break;
+                }
+                if (got == 0) first = hdr.due_ns;
+                lat[got++] = (double)(int64_t)(now - hdr.due_ns) / 1e9;
+                next = hdr.seq + 1;
+                last = now;
+            }
+            if (rc < 0) break;
+            msgs[0].msg_hdr.msg_namelen = sizeof(from);
+        }
+        if (rc < 0) break;
+
+        uint64_t bad = 0;
+        for (uint64_t i = 0; verify && i < got; i++) {
+            if (crc32c(0, buf + i * frame + sizeof(frame_hdr_t), size) != expected) bad++;
+        }
+        mismatches += bad;
+
+        ipc_latency_t l = { .rate = pace };
+        lat_summarize(lat, got, &l);
+        double span = got > 1 ? (last - first) / 1e9 : 0;
+        lat_print("[Child] ", batch, span > 0 ? got / span : 0, &l);
+        printf("[Child]              %.3f calls/message, %.2f MB/sec, %" PRIu64 " lost\n",
+               got ? (double)calls / got : 0, span > 0 ? got * size / span / 1e6 : 0, count - got);
+
+        // elapsed is the cost per delivered message, so bytes_per_sec is the payload throughput
+        char label[64];
+        snprintf(label, sizeof(label), "udp-batch-%d", batch);
+        ipc_result_t result = { label, size, got ? span / got : 0, verify ? bad == 0 : -1, &l };
+        result_emit(format, output, &result);
+
+        char ack = 1;
+        if (got == 0 || sendto(fd, &ack, 1, 0, (struct sockaddr *)&from, sizeof(from)) != 1) {
+            fprintf(stderr, "Child: Cannot acknowledge step %d\n", batch);
+            rc = -1;
+        }
+    }
+
+    if (verify) {
+        if (mismatches) printf("[Child] Verified:     FAILED (%" PRIu64 " datagrams with a bad crc32c)\n", mismatches);
+        else printf("[Child] Verified:     OK (crc32c 0x%08x, %s)\n", expected, crc32c_impl());
+        if (mismatches) rc = -1;
+    }
+
+    free(buf);
+    free(iov);
+    free(msgs);
+    free(lat);
+    return rc;
+}
+
 int main(int argc, char *argv[]) {
-    int size = 0;
+    uint64_t size = 0;
+    int perf = 0;
+    int trace_table = 0;
+    const char *trace_json = NULL;
+    int verify = 0;  // 1: checksum outside the timed region, 2: inside
+    int format = RESULT_TEXT;
+    const char *output = NULL;  // Append records here instead of stdout
+    int pattern = PATTERN_SEQ;
+    long src_align = -1, dst_align = -1;  // Payload offsets in a page; -1 leaves malloc() placement
+    double batches[MAX_STEPS];
+    int nbatches = 0;     // Batched when non-zero
+    double pace = -1;     // Batched datagrams/sec, 0 unpaced; -1 until set, then BATCH_PACE
+    uint64_t count = 10000;  // Datagrams per batch step
 
     static struct option long_options[] = {
         {"size", required_argument, 0, 's'},
+        {"perf", no_argument, 0, 'P'},
+        {"trace", no_argument, 0, 'T'},
+        {"trace-json", required_argument, 0, 'J'},
+        {"verify", no_argument, 0, 'V'},
+        {"verify-timed", no_argument, 0, 'I'},
+        {"batch", required_argument, 0, 'b'},
+        {"pace", required_argument, 0, 'p'},
+        {"count", required_argument, 0, 'c'},
+        {"pattern", required_argument, 0, 'D'},
+        {"align", required_argument, 0, 'A'},
+        {"format", required_argument, 0, 'f'},
+        {"output", required_argument, 0, 'o'},
         {0, 0, 0, 0}
     };
 
     while (1) {
         int option_index = 0;
-        int c = getopt_long(argc, argv, "s:", long_options, &option_index);
+        int c = getopt_long(argc, argv, "s:PTJ:VIb:p:c:D:A:f:o:", long_options, &option_index);
         if (c == -1) break;
 
         switch (c) {
             case 's':
-                size = atoi(optarg);
+                if (parse_size(optarg, &size) < 0) {
+                    fprintf(stderr, "Invalid size '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'P':
+                perf = 1;
+                break;
+            case 'T':
+                trace_table = 1;
+                break;
+            case 'J':
+                trace_json = optarg;
+                break;
+            case 'V':
+                verify = 1;
+                break;
+            case 'I':
+                verify = 2;
+                break;
+            case 'b':
+                nbatches = lat_parse_steps(optarg, batches, MAX_STEPS);
+                for (int i = 0; i < nbatches; i++) {
+                    if (batches[i] < 1 || batches[i] > MAX_BATCH || batches[i] != (int)batches[i]) nbatches = -1;
+                }
+                if (nbatches <= 0) {
+                    fprintf(stderr, "Invalid batch '%s' (1 to %d, e.g. 1,8,64 or 1:256).\n", optarg, MAX_BATCH);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'p': {
+                char *end;
+                pace = strtod(optarg, &end);
+                if (end == optarg || *end || pace < 0) {
+                    fprintf(stderr, "Invalid pace '%s' (datagrams/sec, 0 for unpaced).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            }
+            case 'c':
+                if (parse_size(optarg, &count) < 0 || count == 0 || count > UINT32_MAX) {
+                    fprintf(stderr, "Invalid count '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'D':
+                pattern = payload_pattern_parse(optarg);
+                if (pattern < 0) {
+                    fprintf(stderr, "Invalid pattern '%s' (expected seq, random or zero).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'A':
+                if (payload_align_parse(optarg, &src_align, &dst_align) < 0) {
+                    fprintf(stderr, "Invalid alignment '%s' (SRC[,DST] bytes past a page boundary).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'f':
+                format = result_format_parse(optarg);
+                if (format < 0) {
+                    fprintf(stderr, "Invalid format '%s' (expected text, json or csv).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'o':
+                output = optarg;
                 break;
             default:
-                fprintf(stderr, "Usage: %s --size NUMBER\n", argv[0]);
+                fprintf(stderr, "Usage: %s --size NUMBER [--perf] [--trace] [--trace-json FILE] [--verify|--verify-timed] [--batch LIST [--pace R] [--count N]] [--pattern seq|random|zero] [--align SRC[,DST]] [--format text|json|csv] [--output FILE]\n", argv[0]);
                 return EXIT_FAILURE;
         }
     }
 
-    if (size <= 0) {
+    result_redirect_text(format, output);
+
+    if (size == 0) {
         fprintf(stderr, "Invalid size specified.\n");
         return EXIT_FAILURE;
     }
+    if (pace >= 0 && !nbatches) {
+        fprintf(stderr, "--pace applies to --batch only.\n");
+        return EXIT_FAILURE;
+    }
+    if (pace < 0) pace = BATCH_PACE;
+    if (nbatches && (pattern != PATTERN_SEQ || src_align >= 0)) {
+        fprintf(stderr, "--pattern and --align apply to single transfers only.\n");
+        return EXIT_FAILURE;
+    }
 
     size_t total_size = sizeof(buf_data_t) + size;
+    size_t header = nbatches ? sizeof(frame_hdr_t) : sizeof(buf_data_t);
+    if (size > UDP_MAX_PAYLOAD - header) {
+        fprintf(stderr, "Size too large for one datagram (max %zu bytes).\n", UDP_MAX_PAYLOAD - header);
+        return EXIT_FAILURE;
+    }
 
     // Allocate and prepare source buffer
-    buf_data_t *src = malloc(total_size);
+    payload_buf_t sb;
+    buf_data_t *src = payload_alloc(&sb, sizeof(buf_data_t), size, src_align, pattern == PATTERN_ZERO);
     if (!src) {
         perror("malloc");
         return EXIT_FAILURE;
     }
     src->size = size;
-    for (int i = 0; i < size; i++) {
-        src->data[i] = (uint8_t)i;
-    }
+    payload_fill(src->data, size, pattern);
+
+    // Shared between parent and child, so it must exist before fork
+    ipc_trace_t *trace = NULL;
+    if (trace_table || trace_json) trace = ipc_trace_create();
+
+    // Install before fork so the child's ready signal cannot arrive first
+    signal(SIGUSR1, handle_sigusr1);
 
     pid_t child_pid = fork();
     if (child_pid < 0) {
         perror("fork");
-        free(src);
+        payload_free(&sb);
         return EXIT_FAILURE;
     }
 
@@ -104,26 +448,63 @@ int main(int argc, char *argv[]) {
             exit(EXIT_FAILURE);
         }
 
+        perf_counters_t pc;
+        if (perf) perf_counters_open(&pc);
+        if (perf) perf_counters_start(&pc);
+
         // Notify parent
         kill(getppid(), SIGUSR1);
 
         // Allocate destination buffer
-        buf_data_t *dst = malloc(total_size);
+        payload_buf_t db;
+        buf_data_t *dst = payload_alloc(&db, sizeof(buf_data_t), size, dst_align, 0);
         if (!dst) {
             perror("Child malloc");
             close(sockfd);
             exit(EXIT_FAILURE);
         }
 
-        ssize_t received = recvfrom(sockfd, dst, total_size, 0, NULL, NULL);
+        // Only when tracing: separate the wakeup from the receive copy
+        if (trace) {
+            struct pollfd pfd = { .fd = sockfd, .events = POLLIN };
+            poll(&pfd, 1, -1);
+            ipc_trace_mark(trace, IPC_TRACE_CHILD, "receiver wakeup");
+        }
+
+        if (nbatches) {
+            int ok = batch_receive(sockfd, batches, nbatches, count, pace, size, verify, format, output) == 0;
+            if (perf) {
+                perf_counters_stop(&pc);
+                perf_counters_print(&pc, "[Child] ");
+                perf_counters_close(&pc);
+            }
+            payload_free(&db);
+            close(sockfd);
+            exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+
+        ssize_t received = recvfrom(sockfd, dst, total_size, MSG_TRUNC, NULL, NULL);
+        ipc_trace_mark(trace, IPC_TRACE_CHILD, "last chunk");
         if (received < 0) {
             perror("Child recvfrom");
-            free(dst);
+            payload_free(&db);
+            close(sockfd);
+            exit(EXIT_FAILURE);
+        }
+        if ((size_t)received != total_size) {
+            fprintf(stderr, "Child: Truncated datagram (%zd of %zu bytes)\n", received, total_size);
+            payload_free(&db);
             close(sockfd);
             exit(EXIT_FAILURE);
         }
 
+        uint32_t crc = 0;
+        if (verify == 2) crc = crc32c(0, dst->data, size);
+
         gettimeofday(&dst->end, NULL);
+        if (perf) perf_counters_stop(&pc);
+
+        if (verify == 1) crc = crc32c(0, dst->data, size);
 
         // Calculate elapsed time
         long sec = dst->end.tv_sec - dst->start.tv_sec;
@@ -140,21 +521,33 @@ int main(int argc, char *argv[]) {
         printf("[Child] Elapsed Time: %.6f seconds\n", elapsed);
         printf("[Child] Transferred:  %zu bytes\n", bytes);
         printf("[Child] Throughput:   %.2f bytes/sec (%.2f MB/sec)\n", bps, mbps);
+        result_print_peak("[Child] ", bps);
+        ipc_trace_mark(trace, IPC_TRACE_CHILD, "post-processing");
+        if (perf) {
+            perf_counters_print(&pc, "[Child] ");
+            perf_counters_close(&pc);
+        }
+
+        int ok = !verify || (crc32c_report_size("[Child] ", size, dst->size) == 0 &&
+                                crc32c_report("[Child] ", dst->crc, crc) == 0);
+
+        long src_offset = payload_offset(src_align, pattern == PATTERN_ZERO);
+        ipc_payload_t pl = { payload_pattern_names[pattern], src_offset, dst_align };
+        ipc_result_t result = { "udp", dst->size, elapsed, verify ? ok : -1, NULL, &pl };
+        result_emit(format, output, &result);
 
-        free(dst);
+        payload_free(&db);
         close(sockfd);
-        exit(EXIT_SUCCESS);
+        exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
     } else {
         // --- Parent Process ---
-        signal(SIGUSR1, handle_sigusr1);
-
         while (!sigusr1_received) pause();
 
         // Create socket for sending
         int sockfd = socket(AF_INET, SOCK_DGRAM, 0);
         if (sockfd < 0) {
             perror("Parent socket");
-            free(src);
+            payload_free(&sb);
             return EXIT_FAILURE;
         }
 
@@ -164,18 +557,48 @@ int main(int argc, char *argv[]) {
         addr.sin_port = htons(UDP_PORT);
         addr.sin_addr.s_addr = inet_addr(LOCALHOST);
 
+        perf_counters_t pc;
+        if (perf) perf_counters_open(&pc);
+
+        if (verify == 1) src->crc = crc32c(0, src->data, size);
+
         // Get start time and send buffer
+        if (perf) perf_counters_start(&pc);
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "pre-send");
         gettimeofday(&src->start, NULL);
 
-        ssize_t sent = sendto(sockfd, src, total_size, 0,
-                              (struct sockaddr *)&addr, sizeof(addr));
-        if (sent < 0) {
-            perror("Parent sendto");
+        if (verify == 2) src->crc = crc32c(0, src->data, size);
+
+        int failed = 0;
+        if (nbatches) {
+            // Connected, so sendmmsg() needs no addresses and only the
+            // child's acknowledgements are received
+            failed = connect(sockfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+                     batch_send(sockfd, batches, nbatches, count, pace, src->data, size) < 0;
+        } else {
+            ssize_t sent = sendto(sockfd, src, total_size, 0,
+                                  (struct sockaddr *)&addr, sizeof(addr));
+            if (sent < 0) {
+                perror("Parent sendto");
+            }
         }
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "send return");
+        if (perf) perf_counters_stop(&pc);
 
         close(sockfd);
-        wait(NULL);
-        free(src);
+        int status;
+        wait(&status);
+        if (perf) {
+            perf_counters_print(&pc, "[Parent] ");
+            perf_counters_close(&pc);
+        }
+
+        if (trace_table) ipc_trace_print_table(trace);
+        if (trace_json) ipc_trace_write_chrome(trace, trace_json);
+        ipc_trace_destroy(trace);
+        payload_free(&sb);
+
+        if (failed || !WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) return EXIT_FAILURE;
     }
 
     return EXIT_SUCCESS;
@@ -9,6 +9,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <inttypes.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/time.h>
@@ -16,11 +17,21 @@
 #include <signal.h>
 #include <errno.h>
 #include <sys/wait.h>
+#include <limits.h>
+#include "perfcount.h"
+#include "crc32c.h"
+#include "ipcstream.h"
+#include "ipcresult.h"
+#include "ipctrace.h"
+
+// Wire payload: [start_time][crc32c][data]
+#define PAYLOAD_HDR (sizeof(struct timeval) + sizeof(uint32_t))
 
 typedef struct {
     struct timeval start;
     struct timeval end;
-    uint32_t size;
+    uint64_t size;
+    uint32_t crc;       // CRC32C of data[], set by the sender with --verify
     uint8_t data[];
 } buf_data_t;
 
@@ -31,33 +42,83 @@ void handle_sigusr1(int sig) {
 }
 
 int main(int argc, char *argv[]) {
-    int size = 0;
+    uint64_t size = 0;
+    int perf = 0;
+    int trace_table = 0;
+    const char *trace_json = NULL;
+    int verify = 0;  // 1: checksum outside the timed region, 2: inside
+    int format = RESULT_TEXT;
+    const char *output = NULL;  // Append records here instead of stdout
 
     static struct option long_options[] = {
         {"size", required_argument, 0, 's'},
+        {"perf", no_argument, 0, 'P'},
+        {"trace", no_argument, 0, 'T'},
+        {"trace-json", required_argument, 0, 'J'},
+        {"verify", no_argument, 0, 'V'},
+        {"verify-timed", no_argument, 0, 'I'},
+        {"format", required_argument, 0, 'f'},
+        {"output", required_argument, 0, 'o'},
         {0, 0, 0, 0}
     };
 
     while (1) {
         int option_index = 0;
-        int c = getopt_long(argc, argv, "s:", long_options, &option_index);
+        int c = getopt_long(argc, argv, "s:PTJ:VIf:o:", long_options, &option_index);
         if (c == -1) break;
 
         switch (c) {
             case 's':
-                size = atoi(optarg);
+                if (parse_size(optarg, &size) < 0) {
+                    fprintf(stderr, "Invalid size '%s'.\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'P':
+                perf = 1;
+                break;
+            case 'T':
+                trace_table = 1;
+                break;
+            case 'J':
+                trace_json = optarg;
+                break;
+            case 'V':
+                verify = 1;
+                break;
+            case 'I':
+                verify = 2;
+                break;
+            case 'f':
+                format = result_format_parse(optarg);
+                if (format < 0) {
+                    fprintf(stderr, "Invalid format '%s' (expected text, json or csv).\n", optarg);
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'o':
+                output = optarg;
                 break;
             default:
-                fprintf(stderr, "Usage: %s --size NUMBER\n", argv[0]);
+                fprintf(stderr, "Usage: %s --size NUMBER [--perf] [--trace] [--trace-json FILE] [--verify|--verify-timed] [--format text|json|csv] [--output FILE]\n", argv[0]);
                 return EXIT_FAILURE;
         }
     }
 
-    if (size <= 0) {
+    result_redirect_text(format, output);
+
+    if (size == 0) {
         fprintf(stderr, "Invalid size specified.\n");
         return EXIT_FAILURE;
     }
 
+    // zmq_recv reports the message length as an int
+    if (size > INT_MAX - PAYLOAD_HDR) {
+        fprintf(stderr, "Size too large for one zmq message (max %zu bytes).\n",
+                (size_t)INT_MAX - PAYLOAD_HDR);
+        return EXIT_FAILURE;
+    }
+
     size_t total_size = sizeof(buf_data_t) + size;
 
     buf_data_t *src = malloc(total_size);
@@ -67,10 +128,17 @@ int main(int argc, char *argv[]) {
     }
 
     src->size = size;
-    for (int i = 0; i < size; i++) {
+    for (uint64_t i = 0; i < size; i++) {
         src->data[i] = (uint8_t)i;
     }
 
+    // Shared between parent and child, so it must exist before fork
+    ipc_trace_t *trace = NULL;
+    if (trace_table || trace_json) trace = ipc_trace_create();
+
+    // Install before fork so the child's ready signal cannot arrive first
+    signal(SIGUSR1, handle_sigusr1);
+
     pid_t child_pid = fork();
     if (child_pid < 0) {
         perror("fork");
@@ -88,10 +156,14 @@ int main(int argc, char *argv[]) {
             exit(EXIT_FAILURE);
         }
 
+        perf_counters_t pc;
+        if (perf) perf_counters_open(&pc);
+        if (perf) perf_counters_start(&pc);
+
         kill(getppid(), SIGUSR1);  // Notify parent
 
         // Allocate buffer
-        size_t max_recv = sizeof(struct timeval) + size;
+        size_t max_recv = PAYLOAD_HDR + size;
         uint8_t *recv_buf = malloc(max_recv);
         if (!recv_buf) {
             perror("malloc");
@@ -99,14 +171,21 @@ int main(int argc, char *argv[]) {
         }
 
         int received = zmq_recv(receiver, recv_buf, max_recv, 0);
-        if (received < (int)sizeof(struct timeval)) {
+        ipc_trace_mark(trace, IPC_TRACE_CHILD, "last chunk");
+        if (received != (int)max_recv) {
             fprintf(stderr, "[Child] Incomplete data received\n");
             exit(EXIT_FAILURE);
         }
 
+        uint32_t crc = 0;
+        if (verify == 2) crc = crc32c(0, recv_buf + PAYLOAD_HDR, size);
+
         struct timeval start, end;
         memcpy(&start, recv_buf, sizeof(struct timeval));
         gettimeofday(&end, NULL);
+        if (perf) perf_counters_stop(&pc);
+
+        if (verify == 1) crc = crc32c(0, recv_buf + PAYLOAD_HDR, size);
 
         long sec = end.tv_sec - start.tv_sec;
         long usec = end.tv_usec - start.tv_usec;
@@ -120,16 +199,28 @@ int main(int argc, char *argv[]) {
         double mbps = bps / 1e6;
 
         printf("[Child] Elapsed Time: %.6f seconds\n", elapsed);
-        printf("[Child] Transferred:  %d bytes\n", size);
+        printf("[Child] Transferred:  %" PRIu64 " bytes\n", size);
         printf("[Child] Throughput:   %.2f bytes/sec (%.2f MB/sec)\n", bps, mbps);
+        result_print_peak("[Child] ", bps);
+        ipc_trace_mark(trace, IPC_TRACE_CHILD, "post-processing");
+        if (perf) {
+            perf_counters_print(&pc, "[Child] ");
+            perf_counters_close(&pc);
+        }
+
+        uint32_t sent_crc;
+        memcpy(&sent_crc, recv_buf + sizeof(struct timeval), sizeof(sent_crc));
+        int ok = !verify || crc32c_report("[Child] ", sent_crc, crc) == 0;
+
+        ipc_result_t result = { "zmq", size, elapsed, verify ? ok : -1 };
+        result_emit(format, output, &result);
 
         free(recv_buf);
         zmq_close(receiver);
         zmq_ctx_term(context);
-        exit(EXIT_SUCCESS);
+        exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
     } else {
         // --- Parent Process (Sender) ---
-        signal(SIGUSR1, handle_sigusr1);
         while (!sigusr1_received) pause();
 
         void *context = zmq_ctx_new();
@@ -140,20 +231,43 @@ int main(int argc, char *argv[]) {
             return EXIT_FAILURE;
         }
 
-        // Create payload: [start_time][data]
+        perf_counters_t pc;
+        if (perf) perf_counters_open(&pc);
+
+        if (verify == 1) src->crc = crc32c(0, src->data, size);
+
+        // Create payload: [start_time][crc32c][data]
+        if (perf) perf_counters_start(&pc);
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "pre-send");
         gettimeofday(&src->start, NULL);
-        size_t payload_size = sizeof(struct timeval) + size;
+        if (verify == 2) src->crc = crc32c(0, src->data, size);
+        size_t payload_size = PAYLOAD_HDR + size;
         uint8_t *payload = malloc(payload_size);
         memcpy(payload, &src->start, sizeof(struct timeval));
-        memcpy(payload + sizeof(struct timeval), src->data, size);
+        memcpy(payload + sizeof(struct timeval), &src->crc, sizeof(uint32_t));
+        memcpy(payload + PAYLOAD_HDR, src->data, size);
 
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "payload built");
         zmq_send(sender, payload, payload_size, 0);
+        ipc_trace_mark(trace, IPC_TRACE_PARENT, "send return");
+        if (perf) perf_counters_stop(&pc);
 
         free(payload);
         zmq_close(sender);
         zmq_ctx_term(context);
         free(src);
-        wait(NULL);
+        int status;
+        wait(&status);
+        if (perf) {
+            perf_counters_print(&pc, "[Parent] ");
+            perf_counters_close(&pc);
+        }
+
+        if (trace_table) ipc_trace_print_table(trace);
+        if (trace_json) ipc_trace_write_chrome(trace, trace_json);
+        ipc_trace_destroy(trace);
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS) return EXIT_FAILURE;
     }
 
     return EXIT_SUCCESS;